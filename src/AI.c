@@ -1,7 +1,12 @@
+#define _DEFAULT_SOURCE  // nanosleep
+
 #include "AI.h"
+#include "book.h"
+#include "ponder.h"
 
 #include <stdio.h> // debugging
 #include <math.h> // to have other options in eval
+#include <time.h>
 
 /* The tuning knobs for the eval function are defined here as constants */
 
@@ -12,6 +17,79 @@ static uint32_t DEPTH_1_SCORE = 6500;
 static uint32_t DEPTH_2_SCORE = 250000;
 
 
+/* Depth used in play at a given score, for a requested minimum depth */
+uint32_t playDepth(uint32_t score, uint32_t depth)
+{
+	if (score < DEPTH_1_SCORE)
+		return depth;
+	else if (score < DEPTH_2_SCORE)
+		return (depth > 1) ? depth : 1;
+	else
+		return (depth > 2) ? depth : 2;
+}
+
+/* The default policy: depth from score alone */
+uint32_t scoreDepthPolicy(const diveState *game, const lookaheadTree roots[4], uint32_t depth)
+{
+	return playDepth(game->score, depth);
+}
+
+/* Spawn options a search from these roots will face on its first ply.  The
+ * cost of a search grows roughly as this to the power of the depth.
+ */
+uint32_t predictedBranching(const lookaheadTree roots[4])
+{
+	uint32_t branching = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		const diveState *s = &roots[i].myState;
+		uint32_t options = s->gameOver ? 0 : s->emptyTiles * s->numSeeds;
+		branching = (options > branching) ? options : branching;
+	}
+	return branching;
+}
+
+static dangerParams DANGER_PARAMS = {3, 4, 75, 24, 64};
+
+dangerParams getDangerParams()
+{
+	return DANGER_PARAMS;
+}
+
+void setDangerParams(dangerParams params)
+{
+	DANGER_PARAMS = params;
+}
+
+/* Starts from the score policy.  Dangerous positions, crowded, with many
+ * seeds or with two big seeds of similar size competing for the board, get
+ * one more ply when the branching is small enough to afford it.
+ * Calm positions above the requested depth drop a ply when the branching
+ * would make the search expensive.
+ */
+uint32_t dangerDepthPolicy(const diveState *game, const lookaheadTree roots[4], uint32_t depth)
+{
+	uint32_t myDepth = playDepth(game->score, depth);
+	uint32_t branching = predictedBranching(roots);
+	bool danger = game->emptyTiles <= DANGER_PARAMS.crowdedTiles
+	           || game->numSeeds >= DANGER_PARAMS.manySeeds
+	           || 100ull * game->secondBiggestSeed >= (uint64_t) DANGER_PARAMS.closeSeedsPercent * game->biggestSeed;
+
+	if (danger && branching <= DANGER_PARAMS.cheapBranching)
+		return myDepth + 1;
+	if (!danger && branching > DANGER_PARAMS.expensiveBranching && myDepth > depth)
+		return myDepth - 1;
+	return myDepth;
+}
+
+static depthPolicy DEPTH_POLICY = scoreDepthPolicy;
+
+void setDepthPolicy(depthPolicy policy)
+{
+	DEPTH_POLICY = policy;
+}
+
+
 /* The board's score when evaluated is the weighted sum of 5 quantities:
  * number of empty tiles
  * inverse seed count
@@ -55,6 +133,49 @@ float linlog(uint32_t value)
 
 
 
+/* Count of lookahead nodes allocated so far, so callers can measure the
+ * size of a search.  Reset it before the search of interest.  Nodes still
+ * allocated are tracked too, with their high-water mark since the reset.
+ * Pondering allocates and frees on other threads, hence the atomics.
+ */
+static uint64_t nodeCount = 0;
+static uint64_t liveNodes = 0;
+static uint64_t peakNodes = 0;
+
+void resetNodeCount()
+{
+	nodeCount = 0;
+	__atomic_store_n(&peakNodes, __atomic_load_n(&liveNodes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+uint64_t getNodeCount()
+{
+	return nodeCount;
+}
+
+uint64_t getPeakNodes()
+{
+	return __atomic_load_n(&peakNodes, __ATOMIC_RELAXED);
+}
+
+static void countAllocated(uint64_t nodes)
+{
+	nodeCount += nodes;
+	uint64_t live = __atomic_add_fetch(&liveNodes, nodes, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&peakNodes, __ATOMIC_RELAXED);
+	while (live > peak && !__atomic_compare_exchange_n(&peakNodes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/* Frees the leaves array of node alone, whose leaves must have been freed or
+ * handed on already.
+ */
+void freeLeaves(lookaheadTree *node)
+{
+	__atomic_sub_fetch(&liveNodes, node->numLeaves, __ATOMIC_RELAXED);
+	free(node->leaves);
+}
+
 /* We will be doing heap allocations, so all eliminated branches will
  * need to be freed from the leaves up.  Define a recursive free:
  */
@@ -62,7 +183,7 @@ void freeNode(lookaheadTree *node)
 {
 	for (uint32_t i = 0; i < node->numLeaves; ++i)
 		freeNode(node->leaves + i);
-	free(node->leaves);
+	freeLeaves(node);
 }
 
 /* promote a leaf to a node by computing its children.  If called
@@ -78,6 +199,7 @@ void addChildren(lookaheadTree *parent)
 	diveState *options = spawnOptions(parent->myState, &numOptions);
 	parent->numLeaves = 4*numOptions;
 	parent->leaves = malloc(parent->numLeaves * sizeof(lookaheadTree));
+	countAllocated(parent->numLeaves);
 
 	for (uint32_t i = 0; i < numOptions; ++i)
 	{
@@ -163,9 +285,13 @@ float evaluate(diveState *myState)
 	         + INV_SEED_COUNT_WEIGHT / myState->numSeeds;
 }
 
-float evaluateTree(lookaheadTree *node)
+/* Expected fitness of node searched depth plies deep.  Anything a retained or
+ * pondered subtree holds beyond that is ignored, so a move's value never
+ * depends on how much of the tree happened to be built already.
+ */
+float evaluateTree(lookaheadTree *node, uint32_t depth)
 {
-	if (node->numLeaves == 0)
+	if (node->numLeaves == 0 || depth == 0)
 	{
 		diveState tmp = node->myState;
 		shift(&tmp, Up);
@@ -192,10 +318,10 @@ float evaluateTree(lookaheadTree *node)
 
 	for (uint32_t i = 0; i < node->numLeaves; i += 4)
 	{
-		upScore += evaluateTree(node->leaves + i);
-		rightScore += evaluateTree(node->leaves + i + 1);
-		downScore += evaluateTree(node->leaves + i + 2);
-		leftScore += evaluateTree(node->leaves + i + 3);
+		upScore += evaluateTree(node->leaves + i, depth - 1);
+		rightScore += evaluateTree(node->leaves + i + 1, depth - 1);
+		downScore += evaluateTree(node->leaves + i + 2, depth - 1);
+		leftScore += evaluateTree(node->leaves + i + 3, depth - 1);
 	}
 
 	float udMax = (upScore > downScore)  ? upScore : downScore;
@@ -206,6 +332,275 @@ float evaluateTree(lookaheadTree *node)
 }
 
 
+/* The same value as computeToDepth followed by evaluateTree on a fresh node
+ * holding myState, without building the tree.  Spawns and moves are made and
+ * unmade on myState itself, which is left as it was found.  Sums are taken
+ * in the same order as evaluateTree so the results are identical.
+ */
+float searchInPlace(diveState *myState, uint32_t depth)
+{
+	moveUndo undo;
+
+	if (depth == 0)
+	{
+		float maxScore = 0;
+		for (uint32_t d = 0; d < 4; ++d)
+		{
+			makeMove(myState, (dirType) d, &undo);
+			float tmpScore = evaluate(myState);
+			maxScore = (d == 0 || tmpScore > maxScore) ? tmpScore : maxScore;
+			unmakeMove(myState, &undo);
+		}
+		return maxScore;
+	}
+
+	spawnIterator it;
+	initSpawns(&it, myState);
+	if (!it.numOptions)
+		return searchInPlace(myState, 0);
+
+	float scores[4] = {0};
+	nodeCount += 4*it.numOptions;
+
+	while (applySpawn(&it, myState))
+	{
+		for (uint32_t d = 0; d < 4; ++d)
+		{
+			makeMove(myState, (dirType) d, &undo);
+			scores[d] += searchInPlace(myState, depth - 1);
+			unmakeMove(myState, &undo);
+		}
+		undoSpawn(&it, myState);
+	}
+
+	float udMax = (scores[Up] > scores[Down])  ? scores[Up] : scores[Down];
+	float lrMax = (scores[Left] > scores[Right])  ? scores[Left] : scores[Right];
+	float hvMax = (udMax > lrMax) ? udMax : lrMax;
+
+	return hvMax / (4*it.numOptions);
+}
+
+/* Whether chooseMove searches in place rather than through the tree.  In
+ * place uses far less memory but can't keep subtrees from one move to the
+ * next.
+ */
+static bool inPlace = false;
+
+void setInPlaceSearch(bool enabled)
+{
+	inPlace = enabled;
+}
+
+
+/* The top level of the AI: one tree per direction, holding the state after
+ * making that move from the current position.
+ */
+void initRoots(lookaheadTree roots[4], diveState game)
+{
+	diveState tmp = game;
+	shift(&tmp, Up);
+	roots[Up] = (lookaheadTree) {tmp, NULL, 0};
+	tmp = game;
+	shift(&tmp, Right);
+	roots[Right] = (lookaheadTree) {tmp, NULL, 0};
+	tmp = game;
+	shift(&tmp, Down);
+	roots[Down] = (lookaheadTree) {tmp, NULL, 0};
+	tmp = game;
+	shift(&tmp, Left);
+	roots[Left] = (lookaheadTree) {tmp, NULL, 0};
+}
+
+/* Search every root to depth and return the move with the best expected
+ * fitness.  Subtrees already present from earlier searches are reused.
+ */
+dirType chooseMove(lookaheadTree roots[4], uint32_t depth, float fitness[4])
+{
+	float bestFitness = -1.0;
+	dirType best = Up;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (inPlace && !roots[i].numLeaves)
+		{
+			fitness[i] = searchInPlace(&roots[i].myState, depth);
+		}
+		else
+		{
+			if (depth > 0)
+				computeToDepth(roots + i, depth);
+
+			fitness[i] = evaluateTree(roots + i, depth);
+		}
+
+		if (fitness[i] > bestFitness)
+		{
+			bestFitness = fitness[i];
+			best = (dirType) i;
+		}
+	}
+
+	return best;
+}
+
+/* After the move held by chosen has been made and option number spawn has
+ * spawned, giving game, make the roots the four subtrees below that spawn.
+ * The other roots must already be freed.  If chosen was never expanded the
+ * roots are built fresh from game.
+ */
+void descendTree(lookaheadTree roots[4], lookaheadTree *chosen, uint32_t spawn, diveState game)
+{
+	if (!chosen->numLeaves)
+	{
+		initRoots(roots, game);
+		return;
+	}
+
+	for (uint32_t i = 0; i < chosen->numLeaves / 4; ++i)
+		if (i != spawn)
+		{
+			freeNode(chosen->leaves + 4*i);
+			freeNode(chosen->leaves + 4*i + 1);
+			freeNode(chosen->leaves + 4*i + 2);
+			freeNode(chosen->leaves + 4*i + 3);
+		}
+
+	roots[Up] = chosen->leaves[4*spawn];
+	roots[Right] = chosen->leaves[4*spawn+1];
+	roots[Down] = chosen->leaves[4*spawn+2];
+	roots[Left] = chosen->leaves[4*spawn+3];
+	freeLeaves(chosen);
+}
+
+
+/* With resets allowed, a reset policy is asked before every move whether the
+ * game is hopeless and should be abandoned for a new one.
+ */
+
+/* The original rule: still under 25000 points with fewer than 4 empty tiles */
+bool ruleResetPolicy(const diveState *game)
+{
+	return game->score < 25000 && game->emptyTiles < 4;
+}
+
+static rolloutParams ROLLOUT_PARAMS = {25000, 8, 20, 15, 4};
+
+rolloutParams getRolloutParams()
+{
+	return ROLLOUT_PARAMS;
+}
+
+void setRolloutParams(rolloutParams params)
+{
+	ROLLOUT_PARAMS = params;
+}
+
+/* xorshift64, private to rollouts so they don't disturb the game's rand() */
+static uint32_t rolloutRandom(uint64_t *x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+	return *x >> 32;
+}
+
+/* Plays up to horizon moves greedily at depth 0, with spawns from rng.
+ * Returns whether the game was still going at the end.
+ */
+static bool rollout(diveState game, uint32_t horizon, uint64_t *rng)
+{
+	spawnIterator it;
+
+	for (uint32_t n = 0; n < horizon; ++n)
+	{
+		diveState best = game;
+		float bestFitness = -1.0;
+		for (uint32_t d = 0; d < 4; ++d)
+		{
+			diveState tmp = game;
+			shift(&tmp, (dirType) d);
+			float fitness = evaluate(&tmp);
+			if (fitness > bestFitness)
+			{
+				bestFitness = fitness;
+				best = tmp;
+			}
+		}
+
+		if (best.gameOver)
+			return false;
+
+		game = best;
+		initSpawns(&it, &game);
+		if (!it.numOptions)
+			return false;
+		it.next = rolloutRandom(rng) % it.numOptions;
+		applySpawn(&it, &game);
+	}
+
+	return true;
+}
+
+/* Predicts the game's potential from cheap depth 0 rollouts: if too few of
+ * them survive the horizon, the real game is unlikely to get far either.
+ * Only checked on a crowded board below a score cap, where the rule would
+ * reset outright, so the rollouts spare the games that can still recover.
+ * The rollouts are seeded from the position so the policy is deterministic.
+ */
+bool rolloutResetPolicy(const diveState *game)
+{
+	rolloutParams *p = &ROLLOUT_PARAMS;
+	if (game->score >= p->maxScore || game->emptyTiles >= p->crowdedTiles)
+		return false;
+
+	uint64_t rng = hashPosition(game);
+	uint32_t survived = 0;
+	for (uint32_t r = 0; r < p->rollouts; ++r)
+		survived += rollout(*game, p->horizon, &rng);
+
+	return 100 * survived < p->minSurvivalPercent * p->rollouts;
+}
+
+static resetPolicy RESET_POLICY = ruleResetPolicy;
+
+void setResetPolicy(resetPolicy policy)
+{
+	RESET_POLICY = policy;
+}
+
+
+/* Optional observer of every position playGame searches, e.g. to sample
+ * positions for a benchmark corpus.  Called before the search with the depth
+ * about to be used.
+ */
+static positionHook POSITION_HOOK = NULL;
+static void *POSITION_HOOK_CTX = NULL;
+
+void setPositionHook(positionHook hook, void *ctx)
+{
+	POSITION_HOOK = hook;
+	POSITION_HOOK_CTX = ctx;
+}
+
+
+/* Whether to ponder on the chosen tree while waiting for the spawn, and how
+ * long the spawn takes to arrive after each move in milliseconds.  Spawns
+ * are instant unless a delay is set, e.g. to watch a verbose game.
+ */
+static bool PONDER = false;
+static uint32_t SPAWN_DELAY_MS = 0;
+
+void setPondering(bool enabled)
+{
+	PONDER = enabled;
+}
+
+void setSpawnDelay(uint32_t ms)
+{
+	SPAWN_DELAY_MS = ms;
+}
+
+
 /* To have an intlist record of the game, I just allocate a static array
  * to hold the moves.  10000 ints shouldn't be memory that is missed.
  */
@@ -218,9 +613,10 @@ static uint32_t MAX_NUM_MOVES = 10000;
  */
 
 /* Returns the intlist directly, and score and number of moves
- * indirectly.
+ * indirectly.  If depthTime is not NULL, the cpu time spent at each depth
+ * is added to it, including games abandoned by a reset.
  */
-uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verbose, uint32_t *resetTicker, bool canReset)
+uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verbose, uint32_t *resetTicker, bool canReset, double *depthTime)
 {
 	uint32_t *summary;
 	diveState *options;
@@ -228,64 +624,44 @@ uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verb
 	lookaheadTree myTree[4];
 	lookaheadTree temp;
 	float fitness[4];
-	float bestFitness;
 	dirType myMove;
 	uint32_t numOptions;
 	uint32_t myDepth;
+	clock_t moveStart;
 
 
 	reset: 
-	game = (diveState) {{0}, {2}, 1, 2, 2, 2, 0, 16, false};
+	game = initialState();
 	*nthMove = 0;
 	summary = malloc(MAX_NUM_MOVES * sizeof *summary);
 	newSpawn(&game, summary + (*nthMove)++);
 	newSpawn(&game, summary + (*nthMove)++);
 	updateSeeds(&game);
 
-	diveState tmp = game;
-	shift(&tmp, Up);
-	myTree[Up] = (lookaheadTree) {tmp, NULL, 0};
-	tmp = game;
-	shift(&tmp, Right);
-	myTree[Right] = (lookaheadTree) {tmp, NULL, 0};
-	tmp = game;
-	shift(&tmp, Down);
-	myTree[Down] = (lookaheadTree) {tmp, NULL, 0};
-	tmp = game;
-	shift(&tmp, Left);
-	myTree[Left] = (lookaheadTree) {tmp, NULL, 0};
+	initRoots(myTree, game);
+
+	myDepth = depth;
 
 	while(!game.gameOver)
 	{
-		if (canReset && game.score < 25000 && game.emptyTiles < 4)
+		moveStart = clock();
+		if (canReset && RESET_POLICY(&game))
 		{
+			if (depthTime)
+				depthTime[myDepth < NUM_DEPTH_TIMES ? myDepth : NUM_DEPTH_TIMES - 1] += (double) (clock() - moveStart) / CLOCKS_PER_SEC;
 			++(*resetTicker);
 			free(summary);
+			for (uint32_t i = 0; i < 4; ++i)
+				freeNode(myTree + i);
 			goto reset;
 		}
-		if (game.score < DEPTH_1_SCORE)
-			myDepth = depth;
-		else if (game.score < DEPTH_2_SCORE)
-			myDepth = (depth > 1) ? depth : 1;
-		else
-			myDepth = (depth > 2) ? depth : 2;
-
-		bestFitness = -1.0;
-		for (uint32_t i = 0; i < 4; ++i)
-		{			
-			if (myDepth > 0)
-				computeToDepth(myTree + i, myDepth);
-
-			fitness[i] = evaluateTree(myTree + i);
-
-			if (fitness[i] > bestFitness)
-			{
-				bestFitness = fitness[i];
-				summary[*nthMove] = i;
-			}
-		}
+		myDepth = DEPTH_POLICY(&game, myTree, depth);
+		if (POSITION_HOOK)
+			POSITION_HOOK(&game, myDepth, POSITION_HOOK_CTX);
 
-		myMove = (dirType) summary[*nthMove];
+		if (!bookMove(&game, myDepth, &myMove))
+			myMove = chooseMove(myTree, myDepth, fitness);
+		summary[*nthMove] = myMove;
 		temp = myTree[myMove];
 
 		// Prune unused branches - no memory leaks pls
@@ -293,6 +669,9 @@ uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verb
 			if (i != myMove)
 				freeNode(myTree + i);
 
+		if (PONDER)
+			startPonder(&temp, myDepth);
+
 		
 		options = spawnOptions(temp.myState, &numOptions);
 		++(*nthMove);
@@ -303,40 +682,25 @@ uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verb
 		if (verbose)
 			printBoard(game);
 
-		if (myDepth > 0)
+		if (SPAWN_DELAY_MS)
+			nanosleep(&(struct timespec) {SPAWN_DELAY_MS / 1000, (SPAWN_DELAY_MS % 1000) * 1000000L}, NULL);
+
+		if (PONDER)
 		{
-			for (uint32_t i = 0; i < numOptions; ++i)
-				if (i != summary[*nthMove])
-				{
-					freeNode(temp.leaves + 4*i);
-					freeNode(temp.leaves + 4*i + 1);
-					freeNode(temp.leaves + 4*i + 2);
-					freeNode(temp.leaves + 4*i + 3);
-				}
-
-			myTree[Up] = temp.leaves[4*summary[*nthMove]];
-			myTree[Right] = temp.leaves[4*summary[*nthMove]+1];
-			myTree[Down] = temp.leaves[4*summary[*nthMove]+2];
-			myTree[Left] = temp.leaves[4*summary[*nthMove]+3];
-			free(temp.leaves);
+			stopPonder();
+			ponderDescend(myTree, &temp, summary[*nthMove], game);
 		}
 		else
-		{
-			tmp = game;
-			shift(&tmp, Up);
-			myTree[Up] = (lookaheadTree) {tmp, NULL, 0};
-			tmp = game;
-			shift(&tmp, Right);
-			myTree[Right] = (lookaheadTree) {tmp, NULL, 0};
-			tmp = game;
-			shift(&tmp, Down);
-			myTree[Down] = (lookaheadTree) {tmp, NULL, 0};
-			tmp = game;
-			shift(&tmp, Left);
-			myTree[Left] = (lookaheadTree) {tmp, NULL, 0};
-		}
+			descendTree(myTree, &temp, summary[*nthMove], game);
 		++(*nthMove);
+
+		if (depthTime)
+			depthTime[myDepth < NUM_DEPTH_TIMES ? myDepth : NUM_DEPTH_TIMES - 1] += (double) (clock() - moveStart) / CLOCKS_PER_SEC;
 	}
+	if (PONDER)
+		finishPondering();
+	for (uint32_t i = 0; i < 4; ++i)
+		freeNode(myTree + i);
 	if (verbose)
 		printBoard(game);
 
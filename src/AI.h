@@ -43,11 +43,74 @@ typedef struct lt {
 
 void populateHelpList();
 
+void resetNodeCount();
+uint64_t getNodeCount();
+uint64_t getPeakNodes();
+
+void freeLeaves(lookaheadTree *node);
 void freeNode(lookaheadTree *node);
 void addChildren(lookaheadTree *parent);
 void computeToDepth(lookaheadTree *root, uint32_t depth);
 float evaluate(diveState *myState);
-float evaluateTree(lookaheadTree *node);
-uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verbose, uint32_t *resetTicker, bool canReset);
+float evaluateTree(lookaheadTree *node, uint32_t depth);
+float searchInPlace(diveState *myState, uint32_t depth);
+void setInPlaceSearch(bool enabled);
+/* A depth policy picks the search depth for a move from the position, the
+ * roots about to be searched, and the minimum depth requested with -d.
+ */
+typedef uint32_t (*depthPolicy)(const diveState *game, const lookaheadTree roots[4], uint32_t depth);
+
+/* Thresholds of dangerDepthPolicy, searched for by calibrate.  The defaults
+ * are hand-picked, not fitted, and no setting found so far beats the score
+ * policy on cpu time per point.
+ */
+typedef struct {
+	uint32_t crowdedTiles;        // this many empty tiles or fewer is dangerous
+	uint32_t manySeeds;           // as is this many seeds or more
+	uint32_t closeSeedsPercent;   // or a second seed this close to the biggest
+	uint32_t cheapBranching;      // extra ply affordable at or below this branching
+	uint32_t expensiveBranching;  // calm positions drop a ply above this branching
+} dangerParams;
+
+uint32_t playDepth(uint32_t score, uint32_t depth);
+uint32_t predictedBranching(const lookaheadTree roots[4]);
+uint32_t scoreDepthPolicy(const diveState *game, const lookaheadTree roots[4], uint32_t depth);
+uint32_t dangerDepthPolicy(const diveState *game, const lookaheadTree roots[4], uint32_t depth);
+dangerParams getDangerParams();
+void setDangerParams(dangerParams params);
+void setDepthPolicy(depthPolicy policy);
+
+void initRoots(lookaheadTree roots[4], diveState game);
+dirType chooseMove(lookaheadTree roots[4], uint32_t depth, float fitness[4]);
+void descendTree(lookaheadTree roots[4], lookaheadTree *chosen, uint32_t spawn, diveState game);
+typedef bool (*resetPolicy)(const diveState *game);
+
+/* Settings of rolloutResetPolicy, fitted by calibrate */
+typedef struct {
+	uint32_t maxScore;            // never reset at or above this score
+	uint32_t rollouts;            // depth 0 rollouts per check
+	uint32_t horizon;             // moves per rollout
+	uint32_t minSurvivalPercent;  // reset if fewer rollouts survive the horizon
+	uint32_t crowdedTiles;        // only checked with fewer empty tiles
+} rolloutParams;
+
+bool ruleResetPolicy(const diveState *game);
+bool rolloutResetPolicy(const diveState *game);
+rolloutParams getRolloutParams();
+void setRolloutParams(rolloutParams params);
+void setResetPolicy(resetPolicy policy);
+
+void setPondering(bool enabled);
+void setSpawnDelay(uint32_t ms);
+
+typedef void (*positionHook)(const diveState *game, uint32_t depth, void *ctx);
+void setPositionHook(positionHook hook, void *ctx);
+
+/* playGame can report cpu seconds spent at each depth, the last slot
+ * covering that depth and deeper.
+ */
+#define NUM_DEPTH_TIMES 4
+
+uint32_t *playGame(uint32_t *score, uint32_t *nthMove, uint32_t depth, bool verbose, uint32_t *resetTicker, bool canReset, double *depthTime);
 
 #endif
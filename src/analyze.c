@@ -0,0 +1,226 @@
+/* Replay re-analysis
+ *
+ * Re-simulates saved games and searches every position again a few plies
+ * deeper than play would have searched it.  Wherever the deeper search prefers
+ * a different move, the difference in expected fitness between its choice
+ * and the recorded move is counted as the loss of that move.  Positions are
+ * grouped by the depth play would have used at that score, to show where
+ * extra depth changes decisions.
+ *
+ * Games are independent, so they are spread over one process per core.
+ */
+
+#include "AI.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#define DEPTH_BANDS 4
+
+typedef struct {
+	bool ok;
+	uint32_t score;
+	uint32_t moves;
+	uint32_t positions[DEPTH_BANDS];
+	uint32_t disagreements[DEPTH_BANDS];
+	double loss[DEPTH_BANDS];
+	double maxLoss;
+	uint32_t maxLossMove;
+	double seconds;
+} gameReport;
+
+typedef struct {
+	char **files;
+	gameReport *reports;
+	uint32_t extra;      // plies searched beyond play's depth
+	uint32_t baseDepth;
+} analyzeJob;
+
+static void analyzeGame(uint32_t g, void *ctx)
+{
+	analyzeJob *job = ctx;
+	gameReport *report = job->reports + g;
+	lookaheadTree myTree[4];
+	lookaheadTree temp;
+	float fitness[4];
+	uint32_t numEntries;
+	uint32_t numOptions;
+	diveState *options;
+
+	clock_t start = clock();
+	*report = (gameReport) {false};
+
+	uint32_t *summary = readReplay(job->files[g], &numEntries);
+	if (!summary || numEntries < 2 || numEntries % 2)
+	{
+		free(summary);
+		return;
+	}
+
+	diveState game = initialState();
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		options = spawnOptions(game, &numOptions);
+		if (summary[i] >= numOptions)
+		{
+			free(options);
+			free(summary);
+			return;
+		}
+		game = options[summary[i]];
+		free(options);
+	}
+	updateSeeds(&game);
+	initRoots(myTree, game);
+
+	for (uint32_t n = 2; n < numEntries; n += 2)
+	{
+		dirType recorded = (dirType) summary[n];
+		uint32_t spawn = summary[n + 1];
+		if (recorded > Left)
+		{
+			for (uint32_t i = 0; i < 4; ++i)
+				freeNode(myTree + i);
+			free(summary);
+			return;
+		}
+
+		uint32_t played = playDepth(game.score, job->baseDepth);
+		uint32_t band = played < DEPTH_BANDS ? played : DEPTH_BANDS - 1;
+
+		dirType best = chooseMove(myTree, played + job->extra, fitness);
+		++report->positions[band];
+		if (fitness[best] > fitness[recorded])
+		{
+			double loss = fitness[best] - fitness[recorded];
+			++report->disagreements[band];
+			report->loss[band] += loss;
+			if (loss > report->maxLoss)
+			{
+				report->maxLoss = loss;
+				report->maxLossMove = n / 2 - 1;
+			}
+		}
+
+		temp = myTree[recorded];
+		for (uint32_t i = 0; i < 4; ++i)
+			if (i != recorded)
+				freeNode(myTree + i);
+
+		options = spawnOptions(temp.myState, &numOptions);
+		if (spawn >= numOptions)
+		{
+			free(options);
+			freeNode(&temp);
+			free(summary);
+			return;
+		}
+		game = options[spawn];
+		free(options);
+
+		descendTree(myTree, &temp, spawn, game);
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+		freeNode(myTree + i);
+	free(summary);
+
+	report->ok = true;
+	report->score = game.score;
+	report->moves = numEntries / 2 - 1;
+	report->seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void printUsage(char *name)
+{
+	printf("Usage: %s [-d extra] [-p playdepth] [-j jobs] [-q] Game1.txt ...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t extra = 1;
+	uint32_t baseDepth = 0;
+	uint32_t jobs = numCores();
+	bool quiet = false;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"d:p:j:qh"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'd': extra = atoi(optarg); break;
+			case 'p': baseDepth = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			case 'q': quiet = true; break;
+			default:
+				printUsage(argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	uint32_t ngames = argc - optind;
+	if (!ngames)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	populateHelpList();
+
+	analyzeJob job = {argv + optind, sharedAlloc(ngames * sizeof(gameReport)), extra, baseDepth};
+	runParallel(jobs, ngames, analyzeGame, &job);
+
+	gameReport total = {true};
+	uint32_t failed = 0;
+
+	if (!quiet)
+		printf("%-24s %10s %6s %9s %12s %10s %14s\n", "game", "score", "moves", "disagree", "loss", "loss/move", "worst (move)");
+
+	for (uint32_t g = 0; g < ngames; ++g)
+	{
+		gameReport *r = job.reports + g;
+		if (!r->ok)
+		{
+			fprintf(stderr, "%s: unreadable or inconsistent replay\n", job.files[g]);
+			++failed;
+			continue;
+		}
+
+		uint32_t positions = 0;
+		uint32_t disagreements = 0;
+		double loss = 0;
+		for (uint32_t b = 0; b < DEPTH_BANDS; ++b)
+		{
+			positions += r->positions[b];
+			disagreements += r->disagreements[b];
+			loss += r->loss[b];
+			total.positions[b] += r->positions[b];
+			total.disagreements[b] += r->disagreements[b];
+			total.loss[b] += r->loss[b];
+		}
+		total.seconds += r->seconds;
+
+		if (!quiet)
+			printf("%-24s %10u %6u %8.2f%% %12.1f %10.3f %8.1f (%u)\n", job.files[g], r->score, r->moves,
+				positions ? 100.0 * disagreements / positions : 0.0, loss,
+				positions ? loss / positions : 0.0, r->maxLoss, r->maxLossMove);
+	}
+
+	printf("\nRe-searched %u games at play depth +%u (%.1f cpu seconds)\n", ngames - failed, extra, total.seconds);
+	printf("%-10s %10s %9s %12s %10s\n", "play depth", "positions", "disagree", "loss", "loss/move");
+	for (uint32_t b = 0; b < DEPTH_BANDS; ++b)
+	{
+		if (!total.positions[b])
+			continue;
+		printf("%u%-9s %10u %8.2f%% %12.1f %10.3f\n", b, b == DEPTH_BANDS - 1 ? "+" : "", total.positions[b],
+			100.0 * total.disagreements[b] / total.positions[b], total.loss[b], total.loss[b] / total.positions[b]);
+	}
+
+	sharedFree(job.reports, ngames * sizeof(gameReport));
+	return failed ? 1 : 0;
+}
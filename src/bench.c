@@ -0,0 +1,190 @@
+/* Search benchmark
+ *
+ * Runs the full per-move search, computeToDepth and evaluateTree on the four
+ * roots of a position, over a corpus of positions dumped by
+ * `diveAI --corpus`, at each depth asked for.  Reports wall time, lookahead
+ * nodes and peak tree memory per position, grouped by seed count since that
+ * drives the branching more than anything else.
+ *
+ * Peak tree memory is the high-water mark of lookahead nodes allocated and
+ * not yet freed during the search, as counted by the allocation sites in
+ * AI.c, times the node size.  It leaves out malloc's own overhead.
+ */
+
+#define _DEFAULT_SOURCE  // clock_gettime, getrusage
+
+#include "AI.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define MAX_BUCKETS 22
+
+typedef struct {
+	uint32_t positions;
+	uint32_t skipped;
+	double seconds;
+	uint64_t nodes;
+	uint64_t maxBytes;
+} bucket;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static diveState *readCorpus(const char *filename, uint32_t *numPositions)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+	{
+		perror(filename);
+		return NULL;
+	}
+
+	char line[512];
+	if (!fgets(line, sizeof line, f) || strncmp(line, CORPUS_HEADER, strlen(CORPUS_HEADER)))
+	{
+		fprintf(stderr, "%s: not a corpus (expected \"%s\")\n", filename, CORPUS_HEADER);
+		fclose(f);
+		return NULL;
+	}
+
+	uint32_t size = 1024;
+	diveState *positions = malloc(size * sizeof *positions);
+	*numPositions = 0;
+
+	while (fgets(line, sizeof line, f))
+	{
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (*numPositions == size)
+			positions = realloc(positions, (size *= 2) * sizeof *positions);
+		if (!readState(line, positions + *numPositions))
+		{
+			fprintf(stderr, "%s: malformed position: %s", filename, line);
+			fclose(f);
+			free(positions);
+			return NULL;
+		}
+		++*numPositions;
+	}
+
+	fclose(f);
+	return positions;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t minDepth = 1;
+	uint32_t maxDepth = 3;
+	uint32_t limit = UINT32_MAX;
+	uint64_t maxMB = 2048;
+	bool verbose = false;
+	bool inPlace = false;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"m:d:l:M:ivh"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'm': minDepth = atoi(optarg); break;
+			case 'd': maxDepth = atoi(optarg); break;
+			case 'l': limit = atoi(optarg); break;
+			case 'M': maxMB = atoi(optarg); break;
+			case 'i': inPlace = true; break;
+			case 'v': verbose = true; break;
+			default:
+				printf("Usage: %s [-m mindepth] [-d maxdepth] [-l limit] [-M maxMB] [-i] [-v] corpus.txt\n", argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		printf("Usage: %s [-m mindepth] [-d maxdepth] [-l limit] [-M maxMB] [-i] [-v] corpus.txt\n", argv[0]);
+		return 1;
+	}
+
+	uint32_t numPositions;
+	diveState *positions = readCorpus(argv[optind], &numPositions);
+	if (!positions)
+		return 1;
+	numPositions = (numPositions < limit) ? numPositions : limit;
+
+	populateHelpList();
+	setInPlaceSearch(inPlace);
+
+	lookaheadTree roots[4];
+	float fitness[4];
+
+	printf("%u positions from %s, %lu bytes per node\n", numPositions, argv[optind], (unsigned long) sizeof(lookaheadTree));
+
+	for (uint32_t depth = minDepth; depth <= maxDepth; ++depth)
+	{
+		bucket buckets[MAX_BUCKETS] = {{0}};
+
+		for (uint32_t p = 0; p < numPositions; ++p)
+		{
+			diveState *game = positions + p;
+			bucket *b = buckets + (game->numSeeds < MAX_BUCKETS ? game->numSeeds : MAX_BUCKETS - 1);
+			initRoots(roots, *game);
+
+			/* Skip searches whose tree would not fit.  A search has about
+			 * 4 (4 branching)^depth nodes.
+			 */
+			double predicted = 4;
+			for (uint32_t d = 0; d < depth; ++d)
+				predicted *= 4.0 * predictedBranching(roots);
+			if (!inPlace && predicted * sizeof(lookaheadTree) > maxMB * 1048576.0)
+			{
+				++b->skipped;
+				continue;
+			}
+
+			resetNodeCount();
+			double start = now();
+			chooseMove(roots, depth, fitness);
+			double seconds = now() - start;
+			uint64_t nodes = getNodeCount();
+			uint64_t bytes = getPeakNodes() * sizeof(lookaheadTree);
+
+			for (uint32_t i = 0; i < 4; ++i)
+				freeNode(roots + i);
+
+			++b->positions;
+			b->seconds += seconds;
+			b->nodes += nodes;
+			b->maxBytes = (bytes > b->maxBytes) ? bytes : b->maxBytes;
+
+			if (verbose)
+				printf("depth %u position %u: seeds %u, empty %u, %.3f ms, %lu nodes, %.2f MB\n", depth, p,
+					game->numSeeds, game->emptyTiles, seconds * 1e3, (unsigned long) nodes, bytes / 1048576.0);
+		}
+
+		printf("\nDepth %u\n%5s %9s %8s %12s %14s %13s\n", depth, "seeds", "positions", "skipped", "ms/position", "nodes/position", "peak tree MB");
+		for (uint32_t s = 0; s < MAX_BUCKETS; ++s)
+		{
+			bucket *b = buckets + s;
+			if (!b->positions && !b->skipped)
+				continue;
+			uint32_t n = b->positions ? b->positions : 1;
+			printf("%5u %9u %8u %12.3f %14.0f %13.2f\n", s, b->positions, b->skipped,
+				b->seconds / n * 1e3, (double) b->nodes / n, b->maxBytes / 1048576.0);
+		}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("\nProcess peak resident memory: %.1f MB\n", usage.ru_maxrss / 1024.0);
+
+	free(positions);
+	return 0;
+}
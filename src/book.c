@@ -0,0 +1,131 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "book.h"
+
+static const bookHeader *book = NULL;
+static const bookEntry *bookTable = NULL;
+
+bool loadBook(const char *filename)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		perror(filename);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < sizeof(bookHeader))
+	{
+		fprintf(stderr, "%s: not an opening book\n", filename);
+		close(fd);
+		return false;
+	}
+
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED)
+	{
+		perror(filename);
+		return false;
+	}
+
+	const bookHeader *header = mem;
+	uint32_t slots = header->numSlots;
+	if (memcmp(header->magic, BOOK_MAGIC, 8) || header->version != BOOK_VERSION
+	    || !slots || (slots & (slots - 1)) || header->numEntries >= slots
+	    || st.st_size != sizeof(bookHeader) + (off_t) slots * sizeof(bookEntry))
+	{
+		fprintf(stderr, "%s: not an opening book of version %d\n", filename, BOOK_VERSION);
+		munmap(mem, st.st_size);
+		return false;
+	}
+
+	book = header;
+	bookTable = (const bookEntry *) (header + 1);
+	return true;
+}
+
+/* Looks up game in the loaded book, if any.  Entries are only used in place
+ * of a search at depth, so a book no deeper than play is ignored.
+ */
+bool bookMove(const diveState *game, uint32_t depth, dirType *move)
+{
+	if (!book || book->depth <= depth)
+		return false;
+
+	uint64_t key = hashPosition(game);
+	uint32_t mask = book->numSlots - 1;
+
+	/* Probes stop at an empty slot, or after every slot in a table without one */
+	for (uint32_t i = key & mask, n = 0; n < book->numSlots && bookTable[i].key; i = (i + 1) & mask, ++n)
+		if (bookTable[i].key == key && bookTable[i].score == game->score)
+		{
+			*move = (dirType) bookTable[i].move;
+			return true;
+		}
+
+	return false;
+}
+
+/* Identifies the loaded book by its contents rather than its path: depth,
+ * entry count and an FNV-1a hash of the table.  "-" if no book is loaded.
+ */
+void bookId(char *id, size_t size)
+{
+	if (!book)
+	{
+		snprintf(id, size, "-");
+		return;
+	}
+
+	uint64_t hash = 14695981039346656037ULL;
+	const uint8_t *bytes = (const uint8_t *) bookTable;
+	for (size_t i = 0; i < (size_t) book->numSlots * sizeof(bookEntry); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	snprintf(id, size, "d%u:n%u:%016llx", book->depth, book->numEntries, (unsigned long long) hash);
+}
+
+bool writeBook(const char *filename, const diveState *positions, const dirType *moves, uint32_t numEntries, uint32_t depth)
+{
+	/* Keep the load factor at or below one half so probes stay short */
+	uint32_t slots = 1;
+	while (slots < 2 * numEntries)
+		slots <<= 1;
+
+	bookHeader header = {BOOK_MAGIC, BOOK_VERSION, depth, slots, numEntries};
+	bookEntry *table = calloc(slots, sizeof *table);
+
+	for (uint32_t n = 0; n < numEntries; ++n)
+	{
+		uint64_t key = hashPosition(positions + n);
+		uint32_t i = key & (slots - 1);
+		while (table[i].key && table[i].key != key)
+			i = (i + 1) & (slots - 1);
+		table[i] = (bookEntry) {key, positions[n].score, moves[n]};
+	}
+
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+	{
+		perror(filename);
+		free(table);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof header, 1, f) == 1
+	       && fwrite(table, sizeof *table, slots, f) == slots;
+	ok = !fclose(f) && ok;
+	free(table);
+	return ok;
+}
@@ -0,0 +1,36 @@
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include "dive.h"
+
+/* An opening book maps early game positions to a move found by a deeper
+ * search than play can afford.  On disk it is a header followed by an open
+ * addressing hash table of numSlots entries (a power of two), keyed by
+ * hashPosition and probed linearly from key & (numSlots - 1).  Empty slots
+ * have key 0.  The file is mapped read-only, so any number of concurrent
+ * games share one copy through the page cache.
+ */
+
+#define BOOK_MAGIC "DIVEBOOK"
+#define BOOK_VERSION 1
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t depth;      // depth the moves were searched at
+	uint32_t numSlots;
+	uint32_t numEntries;
+} bookHeader;
+
+typedef struct {
+	uint64_t key;
+	uint32_t score;      // cheap check against hash collisions
+	uint32_t move;
+} bookEntry;
+
+bool loadBook(const char *filename);
+bool bookMove(const diveState *game, uint32_t depth, dirType *move);
+void bookId(char *id, size_t size);
+bool writeBook(const char *filename, const diveState *positions, const dirType *moves, uint32_t numEntries, uint32_t depth);
+
+#endif
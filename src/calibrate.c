@@ -0,0 +1,313 @@
+/* Policy calibration
+ *
+ * Fits the thresholds of dangerDepthPolicy to minimize cpu time per million
+ * points, the quantity the score thresholds were tuned for.  Every candidate
+ * plays the same games (game g from seed + g), so differences between
+ * candidates come from the policy and not from luck of the spawns.  The
+ * score policy is always included as the baseline.
+ *
+ * With -m reset it fits rolloutResetPolicy instead, against the rule policy
+ * and against never resetting.  What a reset policy buys is high scores, so
+ * its cost is cpu time, including the games it gave up on and the time spent
+ * predicting, per finished game scoring at least the target.
+ *
+ * Candidate, game pairs are independent and spread over one process per core.
+ */
+
+#include "AI.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+typedef struct {
+	bool isBaseline;
+	dangerParams params;
+	double seconds;
+	uint64_t points;
+} candidate;
+
+typedef enum {neverReset, ruleReset, rolloutReset} resetKind;
+
+typedef struct {
+	resetKind kind;
+	rolloutParams params;
+	double seconds;
+	uint32_t hits;      // finished games reaching the target
+	uint32_t resets;
+} resetCandidate;
+
+typedef struct {
+	uint32_t score;
+	uint32_t resets;
+	double seconds;
+} gameOutcome;
+
+typedef struct {
+	candidate *candidates;
+	resetCandidate *resetCandidates;
+	gameOutcome *outcomes;   // candidate-major
+	uint32_t ngames;
+	uint32_t depth;
+	uint32_t seed;
+} calibrationJob;
+
+static void playCandidateGame(uint32_t item, void *ctx)
+{
+	calibrationJob *job = ctx;
+	candidate *c = job->candidates + item / job->ngames;
+	uint32_t g = item % job->ngames;
+	double depthTime[NUM_DEPTH_TIMES] = {0};
+	uint32_t score, nthMove, resets = 0;
+
+	setDepthPolicy(c->isBaseline ? scoreDepthPolicy : dangerDepthPolicy);
+	setDangerParams(c->params);
+
+	srand(job->seed + g);
+	free(playGame(&score, &nthMove, job->depth, false, &resets, false, depthTime));
+
+	gameOutcome *out = job->outcomes + item;
+	out->score = score;
+	out->seconds = 0;
+	for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+		out->seconds += depthTime[d];
+}
+
+static void playResetGame(uint32_t item, void *ctx)
+{
+	calibrationJob *job = ctx;
+	resetCandidate *c = job->resetCandidates + item / job->ngames;
+	uint32_t g = item % job->ngames;
+	double depthTime[NUM_DEPTH_TIMES] = {0};
+	uint32_t score, nthMove, resets = 0;
+
+	setResetPolicy(c->kind == rolloutReset ? rolloutResetPolicy : ruleResetPolicy);
+	setRolloutParams(c->params);
+
+	srand(job->seed + g);
+	free(playGame(&score, &nthMove, job->depth, false, &resets, c->kind != neverReset, depthTime));
+
+	gameOutcome *out = job->outcomes + item;
+	out->score = score;
+	out->resets = resets;
+	out->seconds = 0;
+	for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+		out->seconds += depthTime[d];
+}
+
+static double cpuPerMillion(const candidate *c)
+{
+	return c->points ? c->seconds / c->points * 1e6 : 1e300;
+}
+
+static int byCost(const void *a, const void *b)
+{
+	double x = cpuPerMillion(a);
+	double y = cpuPerMillion(b);
+	return (x > y) - (x < y);
+}
+
+static void printCandidate(const candidate *c, uint32_t ngames)
+{
+	char name[64] = "score (baseline)";
+	if (!c->isBaseline)
+		snprintf(name, sizeof name, "danger %u,%u,%u,%u,%u", c->params.crowdedTiles, c->params.manySeeds,
+			c->params.closeSeedsPercent, c->params.cheapBranching, c->params.expensiveBranching);
+	printf("%-38s", name);
+	printf(" %12.3f %12lu %10.2f\n", cpuPerMillion(c), (unsigned long) (c->points / ngames), c->seconds);
+}
+
+static double cpuPerHit(const resetCandidate *c)
+{
+	return c->hits ? c->seconds / c->hits : 1e300;
+}
+
+static int byCostPerHit(const void *a, const void *b)
+{
+	double x = cpuPerHit(a);
+	double y = cpuPerHit(b);
+	return (x > y) - (x < y);
+}
+
+static void printResetCandidate(const resetCandidate *c, uint32_t ngames)
+{
+	if (c->kind == neverReset)
+		printf("%-32s", "never");
+	else if (c->kind == ruleReset)
+		printf("%-32s", "rule (baseline)");
+	else
+		printf("rollout %u,%u,%u,%u,%-8u", c->params.maxScore, c->params.rollouts,
+			c->params.horizon, c->params.minSurvivalPercent, c->params.crowdedTiles);
+	if (c->hits)
+		printf(" %12.3f", cpuPerHit(c));
+	else
+		printf(" %12s", "-");
+	printf(" %6u / %-6u %8.2f%% %10.2f\n", c->hits, ngames,
+		100.0 * ngames / (ngames + c->resets), c->seconds);
+}
+
+static int calibrateReset(uint32_t ngames, uint32_t depth, uint32_t seed, uint32_t jobs, uint32_t top, uint32_t target)
+{
+	static const uint32_t maxScore[] = {25000, 50000};
+	static const uint32_t horizon[] = {20, 30};
+	static const uint32_t survival[] = {15, 50};
+	static const uint32_t crowded[] = {4, 6};
+
+	uint32_t numCandidates = 2 + 2*2*2*2;
+	resetCandidate *candidates = calloc(numCandidates, sizeof *candidates);
+	candidates[0].kind = ruleReset;
+	candidates[1].kind = neverReset;
+	uint32_t n = 2;
+	for (uint32_t a = 0; a < 2; ++a)
+		for (uint32_t b = 0; b < 2; ++b)
+			for (uint32_t c = 0; c < 2; ++c)
+				for (uint32_t e = 0; e < 2; ++e)
+				{
+					candidates[n].kind = rolloutReset;
+					candidates[n++].params = (rolloutParams) {maxScore[a], 8, horizon[b], survival[c], crowded[e]};
+				}
+
+	uint32_t numItems = numCandidates * ngames;
+	calibrationJob job = {NULL, candidates, sharedAlloc(numItems * sizeof(gameOutcome)), ngames, depth, seed};
+
+	printf("Playing %u games for each of %u reset policies on %u processes...\n", ngames, numCandidates, jobs);
+	runParallel(jobs, numItems, playResetGame, &job);
+
+	for (uint32_t i = 0; i < numItems; ++i)
+	{
+		resetCandidate *c = candidates + i / ngames;
+		c->seconds += job.outcomes[i].seconds;
+		c->resets += job.outcomes[i].resets;
+		c->hits += job.outcomes[i].score >= target;
+	}
+	resetCandidate baseline = candidates[0];
+
+	qsort(candidates, numCandidates, sizeof *candidates, byCostPerHit);
+
+	printf("\n%-32s %12s %15s %9s %10s\n", "reset policy", "cpu s/hit", "hits", "complete", "cpu s");
+	printResetCandidate(&baseline, ngames);
+	for (uint32_t i = 0; i < top && i < numCandidates; ++i)
+		printResetCandidate(candidates + i, ngames);
+
+	if (!candidates[0].hits)
+		printf("\nNo policy reached %u; play more games or lower the target\n", target);
+	else if (!baseline.hits)
+		printf("\nThe rule policy never reached %u; play more games or lower the target\n", target);
+	else if (candidates[0].kind == ruleReset)
+		printf("\nNo policy beat the rule policy at reaching %u\n", target);
+	else if (candidates[0].kind == neverReset)
+		printf("\nBest: no resets (%.1f%% of baseline cpu per game reaching %u)\n",
+			100 * cpuPerHit(candidates) / cpuPerHit(&baseline), target);
+	else
+		printf("\nBest: -R rollout --reset-params %u,%u,%u,%u,%u (%.1f%% of baseline cpu per game reaching %u)\n",
+			candidates[0].params.maxScore, candidates[0].params.rollouts, candidates[0].params.horizon,
+			candidates[0].params.minSurvivalPercent, candidates[0].params.crowdedTiles,
+			100 * cpuPerHit(candidates) / cpuPerHit(&baseline), target);
+
+	sharedFree(job.outcomes, numItems * sizeof(gameOutcome));
+	free(candidates);
+	return 0;
+}
+
+static void printUsage(char *name)
+{
+	printf("Usage: %s [-m depth|reset] [-n ngames] [-d depth] [-s seed] [-j jobs] [-k top] [-t target]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t ngames = 20;
+	uint32_t depth = 0;
+	uint32_t seed = time(NULL);
+	uint32_t jobs = numCores();
+	uint32_t top = 10;
+	uint32_t target = 100000;
+	bool resetMode = false;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"m:n:d:s:j:k:t:h"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'm':
+				if (!strcmp(optarg, "depth"))
+					resetMode = false;
+				else if (!strcmp(optarg, "reset"))
+					resetMode = true;
+				else
+				{
+					printUsage(argv[0]);
+					return 1;
+				}
+			break;
+			case 'n': ngames = atoi(optarg); break;
+			case 'd': depth = atoi(optarg); break;
+			case 's': seed = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			case 'k': top = atoi(optarg); break;
+			case 't': target = atoi(optarg); break;
+			default:
+				printUsage(argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	populateHelpList();
+
+	if (resetMode)
+		return calibrateReset(ngames, depth, seed, jobs, top, target);
+
+	static const uint32_t crowded[] = {2, 3, 4};
+	static const uint32_t many[] = {3, 4, 5};
+	static const uint32_t close[] = {50, 75, UINT32_MAX};
+	static const uint32_t cheap[] = {16, 32, 64};
+	static const uint32_t expensive[] = {48, 96, UINT32_MAX};
+
+	uint32_t numCandidates = 1 + 3*3*3*3*3;
+	candidate *candidates = calloc(numCandidates, sizeof *candidates);
+	candidates[0].isBaseline = true;
+	candidates[0].params = getDangerParams();
+	uint32_t n = 1;
+	for (uint32_t a = 0; a < 3; ++a)
+		for (uint32_t b = 0; b < 3; ++b)
+			for (uint32_t s = 0; s < 3; ++s)
+				for (uint32_t c = 0; c < 3; ++c)
+					for (uint32_t e = 0; e < 3; ++e)
+						candidates[n++].params = (dangerParams) {crowded[a], many[b], close[s], cheap[c], expensive[e]};
+
+	uint32_t numItems = numCandidates * ngames;
+	calibrationJob job = {candidates, NULL, sharedAlloc(numItems * sizeof(gameOutcome)), ngames, depth, seed};
+
+	printf("Playing %u games for each of %u depth policies on %u processes...\n", ngames, numCandidates, jobs);
+	runParallel(jobs, numItems, playCandidateGame, &job);
+
+	for (uint32_t i = 0; i < numItems; ++i)
+	{
+		candidates[i / ngames].seconds += job.outcomes[i].seconds;
+		candidates[i / ngames].points += job.outcomes[i].score;
+	}
+	candidate baseline = candidates[0];
+
+	qsort(candidates, numCandidates, sizeof *candidates, byCost);
+
+	printf("\n%-38s %12s %12s %10s\n", "policy", "cpu s/Mpt", "mean score", "cpu s");
+	printCandidate(&baseline, ngames);
+	for (uint32_t i = 0; i < top && i < numCandidates; ++i)
+		printCandidate(candidates + i, ngames);
+
+	if (candidates[0].isBaseline)
+		printf("\nNo danger policy beat the score policy\n");
+	else
+		printf("\nBest: -p danger --depth-params %u,%u,%u,%u,%u (%.1f%% of baseline cpu per point)\n",
+			candidates[0].params.crowdedTiles, candidates[0].params.manySeeds, candidates[0].params.closeSeedsPercent,
+			candidates[0].params.cheapBranching, candidates[0].params.expensiveBranching,
+			100 * cpuPerMillion(candidates) / cpuPerMillion(&baseline));
+
+	sharedFree(job.outcomes, numItems * sizeof(gameOutcome));
+	free(candidates);
+	return 0;
+}
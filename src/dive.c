@@ -136,11 +136,11 @@ void updateSeeds(diveState *myState)
 	myState->numSeeds = newNumSeeds;
 }
 
-void shift(diveState *myState, dirType dir)
+/* Moves and merges the tiles of a live game.  Returns whether anything
+ * merged, in which case the seeds need updating.
+ */
+static bool slide(diveState *myState, dirType dir)
 {
-	if (myState->gameOver)
-		return;
-	
 	/* initialize to zero */
 	uint32_t newBoard[16] = {0};
 	myState->emptyTiles = 16;
@@ -185,7 +185,15 @@ void shift(diveState *myState, dirType dir)
 	myState->gameOver = !memcmp(myState->board, newBoard, 64);
 	memcpy(myState->board, newBoard, 64);
 
-	if (dirty)
+	return dirty;
+}
+
+void shift(diveState *myState, dirType dir)
+{
+	if (myState->gameOver)
+		return;
+
+	if (slide(myState, dir))
 		updateSeeds(myState);
 }
 
@@ -202,7 +210,7 @@ diveState *spawnOptions(diveState myState, uint32_t *numOptions)
 	}
 
 	uint32_t spaces = 0;
-	uint32_t locs[15];
+	uint32_t locs[16];
 
 	for (uint32_t i = 0; i < 16; ++i)
 		if (!myState.board[i])
@@ -231,3 +239,257 @@ void newSpawn(diveState *myState, uint32_t *rng)
 	*myState = options[*rng];
 	free(options);
 }
+
+/* Recompute the derived fields of a state from its board and seed list.  Unlike
+ * updateSeeds this never eliminates or unlocks seeds, so the score is untouched.
+ * Used for states which come from outside a game, e.g. read from text.
+ */
+void refreshState(diveState *myState)
+{
+	myState->maxTile = 0;
+	myState->submaxTile = 0;
+	myState->emptyTiles = 0;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		uint32_t val = myState->board[i];
+		if (!val)
+			myState->emptyTiles += 1;
+		else if (val > myState->maxTile)
+		{
+			myState->submaxTile = myState->maxTile;
+			myState->maxTile = val;
+		}
+		else if (val > myState->submaxTile)
+			myState->submaxTile = val;
+	}
+
+	myState->biggestSeed = 0;
+	myState->secondBiggestSeed = 0;
+
+	for (uint32_t i = 0; i < myState->numSeeds; ++i)
+	{
+		uint32_t seed = myState->seeds[i];
+		if (seed > myState->biggestSeed)
+		{
+			myState->secondBiggestSeed = myState->biggestSeed;
+			myState->biggestSeed = seed;
+		}
+		else if (seed > myState->secondBiggestSeed)
+			myState->secondBiggestSeed = seed;
+	}
+}
+
+/* Two states describe the same position if board, seeds and score agree */
+bool samePosition(const diveState *a, const diveState *b)
+{
+	return a->score == b->score && a->numSeeds == b->numSeeds
+	    && !memcmp(a->board, b->board, sizeof a->board)
+	    && !memcmp(a->seeds, b->seeds, a->numSeeds * sizeof a->seeds[0]);
+}
+
+/* Plain text form of a position, one line:
+ *
+ *   score numSeeds seed_1 ... seed_n board_0 ... board_15
+ *
+ * This is what external tools speak, so it only carries the position itself.
+ */
+void writeState(FILE *f, const diveState *myState)
+{
+	fprintf(f, "%u %u", myState->score, myState->numSeeds);
+	for (uint32_t i = 0; i < myState->numSeeds; ++i)
+		fprintf(f, " %u", myState->seeds[i]);
+	for (uint32_t i = 0; i < 16; ++i)
+		fprintf(f, " %u", myState->board[i]);
+	fprintf(f, "\n");
+}
+
+/* Inverse of writeState.  Returns false on a malformed line. */
+bool readState(const char *line, diveState *myState)
+{
+	char *end;
+	unsigned long vals[2 + 21 + 16];
+	uint32_t count = 0;
+
+	while (count < 2 + 21 + 16)
+	{
+		unsigned long v = strtoul(line, &end, 10);
+		if (end == line)
+			break;
+		vals[count++] = v;
+		line = end;
+	}
+
+	if (count < 2 || vals[1] < 1 || vals[1] > 21 || count != 2 + vals[1] + 16)
+		return false;
+
+	*myState = (diveState) {{0}};
+	myState->score = vals[0];
+	myState->numSeeds = vals[1];
+	for (uint32_t i = 0; i < myState->numSeeds; ++i)
+		if (!(myState->seeds[i] = vals[2 + i]))
+			return false;
+	for (uint32_t i = 0; i < 16; ++i)
+		myState->board[i] = vals[2 + myState->numSeeds + i];
+
+	refreshState(myState);
+	return true;
+}
+
+/* The state every game starts from, before the two opening spawns */
+diveState initialState()
+{
+	return (diveState) {{0}, {2}, 1, 2, 2, 2, 0, 16, false};
+}
+
+/* 64 bit FNV-1a over the fields compared by samePosition.  Never zero, so
+ * that tables can use zero to mark an empty slot.
+ */
+uint64_t hashPosition(const diveState *myState)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	uint32_t words[2 + 21 + 16];
+	uint32_t count = 0;
+
+	words[count++] = myState->score;
+	words[count++] = myState->numSeeds;
+	for (uint32_t i = 0; i < myState->numSeeds; ++i)
+		words[count++] = myState->seeds[i];
+	for (uint32_t i = 0; i < 16; ++i)
+		words[count++] = myState->board[i];
+
+	const uint8_t *bytes = (const uint8_t *) words;
+	for (uint32_t i = 0; i < count * sizeof words[0]; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash ? hash : 1;
+}
+
+/* Reads a replay as written by diveAI: one number per line, the two opening
+ * spawns and then move, spawn pairs.  Returns NULL if the file can't be read,
+ * otherwise an array to be freed.
+ */
+uint32_t *readReplay(const char *filename, uint32_t *numEntries)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+		return NULL;
+
+	uint32_t size = 1024;
+	uint32_t *entries = malloc(size * sizeof *entries);
+	unsigned value;
+
+	*numEntries = 0;
+	while (fscanf(f, "%u", &value) == 1)
+	{
+		if (*numEntries == size)
+			entries = realloc(entries, (size *= 2) * sizeof *entries);
+		entries[(*numEntries)++] = value;
+	}
+	fclose(f);
+
+	return entries;
+}
+
+/* In-place alternatives to spawnOptions and shift, for searches that walk
+ * the game tree on a single state instead of materializing every option.
+ */
+
+/* Prepares to enumerate the spawns of myState in spawnOptions order */
+void initSpawns(spawnIterator *it, const diveState *myState)
+{
+	it->spaces = 0;
+	it->next = 0;
+
+	if (myState->gameOver)
+	{
+		it->numOptions = 1;
+		return;
+	}
+
+	for (uint32_t i = 0; i < 16; ++i)
+		if (!myState->board[i])
+			it->locs[it->spaces++] = i;
+
+	it->numOptions = it->spaces * myState->numSeeds;
+}
+
+/* Applies the next spawn to myState, which must have had the previous one
+ * undone.  Returns false once every option has been visited.
+ */
+bool applySpawn(spawnIterator *it, diveState *myState)
+{
+	if (it->next >= it->numOptions)
+		return false;
+
+	if (!myState->gameOver)
+	{
+		uint32_t seed = it->next / it->spaces;
+		uint32_t loc = it->next % it->spaces;
+		myState->board[it->locs[loc]] = myState->seeds[seed];
+		myState->emptyTiles -= 1;
+	}
+
+	it->last = it->next++;
+	return true;
+}
+
+void undoSpawn(const spawnIterator *it, diveState *myState)
+{
+	if (myState->gameOver)
+		return;
+
+	myState->board[it->locs[it->last % it->spaces]] = 0;
+	myState->emptyTiles += 1;
+}
+
+/* shift, keeping what unmakeMove needs to restore the state.  The seeds and
+ * the fields derived from them are only saved when updateSeeds runs.
+ */
+void makeMove(diveState *myState, dirType dir, moveUndo *undo)
+{
+	undo->moved = !myState->gameOver;
+	undo->dirty = false;
+	if (!undo->moved)
+		return;
+
+	memcpy(undo->board, myState->board, sizeof undo->board);
+	undo->score = myState->score;
+	undo->emptyTiles = myState->emptyTiles;
+
+	if (!slide(myState, dir))
+		return;
+
+	undo->dirty = true;
+	undo->numSeeds = myState->numSeeds;
+	memcpy(undo->seeds, myState->seeds, myState->numSeeds * sizeof undo->seeds[0]);
+	undo->maxTile = myState->maxTile;
+	undo->submaxTile = myState->submaxTile;
+	undo->biggestSeed = myState->biggestSeed;
+	undo->secondBiggestSeed = myState->secondBiggestSeed;
+	updateSeeds(myState);
+}
+
+void unmakeMove(diveState *myState, const moveUndo *undo)
+{
+	if (!undo->moved)
+		return;
+
+	memcpy(myState->board, undo->board, sizeof undo->board);
+	myState->score = undo->score;
+	myState->emptyTiles = undo->emptyTiles;
+	myState->gameOver = false;
+
+	if (!undo->dirty)
+		return;
+
+	myState->numSeeds = undo->numSeeds;
+	memcpy(myState->seeds, undo->seeds, undo->numSeeds * sizeof undo->seeds[0]);
+	myState->maxTile = undo->maxTile;
+	myState->submaxTile = undo->submaxTile;
+	myState->biggestSeed = undo->biggestSeed;
+	myState->secondBiggestSeed = undo->secondBiggestSeed;
+}
@@ -2,6 +2,7 @@
 #define DIVE_H_INCLUDED
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -46,4 +47,49 @@ void shift(diveState *myState, dirType dir);
 diveState *spawnOptions(diveState myState, uint32_t *numOptions);
 void newSpawn(diveState *myState, uint32_t *rng);
 
+/* Enumerates the options of spawnOptions one at a time, applied in place */
+typedef struct {
+	uint8_t locs[16];
+	uint32_t spaces;
+	uint32_t numOptions;
+	uint32_t next;
+	uint32_t last;
+} spawnIterator;
+
+void initSpawns(spawnIterator *it, const diveState *myState);
+bool applySpawn(spawnIterator *it, diveState *myState);
+void undoSpawn(const spawnIterator *it, diveState *myState);
+
+/* What makeMove changed.  A move that merges nothing leaves the seeds alone,
+ * so they are only saved, and only the live ones, when dirty is set.
+ */
+typedef struct {
+	bool moved;          // false if the game was already over
+	bool dirty;          // updateSeeds ran
+	uint8_t emptyTiles;
+	uint32_t board[16];
+	uint32_t score;
+
+	uint32_t numSeeds;
+	uint32_t maxTile;
+	uint32_t submaxTile;
+	uint32_t biggestSeed;
+	uint32_t secondBiggestSeed;
+	uint32_t seeds[21];
+} moveUndo;
+
+void makeMove(diveState *myState, dirType dir, moveUndo *undo);
+void unmakeMove(diveState *myState, const moveUndo *undo);
+
+void refreshState(diveState *myState);
+bool samePosition(const diveState *a, const diveState *b);
+/* First line of a file of positions in writeState form */
+#define CORPUS_HEADER "# dive corpus v1"
+
+void writeState(FILE *f, const diveState *myState);
+bool readState(const char *line, diveState *myState);
+diveState initialState();
+uint64_t hashPosition(const diveState *myState);
+uint32_t *readReplay(const char *filename, uint32_t *numEntries);
+
 #endif
@@ -6,6 +6,8 @@
  */
 
 #include "AI.h"
+#include "book.h"
+#include "results.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -17,6 +19,20 @@
 #include <time.h>
 
 
+/* Writes every sampleInterval-th position searched to the corpus file */
+typedef struct {
+	FILE *f;
+	uint32_t sampleInterval;
+	uint64_t seen;
+} corpusSampler;
+
+static void samplePosition(const diveState *game, uint32_t depth, void *ctx)
+{
+	corpusSampler *sampler = ctx;
+	if (sampler->seen++ % sampler->sampleInterval == 0)
+		writeState(sampler->f, game);
+}
+
 int main(int argc, char **argv)
 {
 	uint32_t ngames = 100;
@@ -24,10 +40,29 @@ int main(int argc, char **argv)
 	uint32_t seed = time(NULL);
 	bool verbose = false;
 	bool canReset = false;
+	char *bookFile = NULL;
+	char *resultFile = NULL;
+	uint32_t shard = 0;
+	uint32_t numShards = 1;
+	bool dangerPolicy = false;
+	dangerParams params = getDangerParams();
+	bool rolloutReset = false;
+	rolloutParams resetParams = getRolloutParams();
+	char *corpusFile = NULL;
+	corpusSampler sampler = {NULL, 10, 0};
+
+	static struct option longOptions[] = {
+		{"shard", required_argument, NULL, 'S'},
+		{"depth-params", required_argument, NULL, 'P'},
+		{"reset-params", required_argument, NULL, 'E'},
+		{"corpus", required_argument, NULL, 'C'},
+		{"sample", required_argument, NULL, 'I'},
+		{0, 0, 0, 0}
+	};
 
 	char opt;
 
-	while ((opt=getopt(argc,argv,"n:d:s:vrh"))!=-1)
+	while ((opt=getopt_long(argc,argv,"n:d:s:vrR:b:io:p:w:Th",longOptions,NULL))!=-1)
 	{
         switch (opt)
         {
@@ -46,26 +81,146 @@ int main(int argc, char **argv)
             case 'r': // Allowed to reset
             	canReset = true;
             break;
+            case 'R': // Reset policy
+            	if (!strcmp(optarg, "rule"))
+            		rolloutReset = false;
+            	else if (!strcmp(optarg, "rollout"))
+            		rolloutReset = true;
+            	else
+            	{
+            		printf("Reset policy must be rule or rollout\n");
+            		return 1;
+            	}
+            break;
+            case 'E': // Settings of the rollout reset policy
+            	if (sscanf(optarg, "%u,%u,%u,%u,%u", &resetParams.maxScore, &resetParams.rollouts, &resetParams.horizon,
+            	           &resetParams.minSurvivalPercent, &resetParams.crowdedTiles) != 5)
+            	{
+            		printf("Reset params must be maxScore,rollouts,horizon,minSurvivalPercent,crowdedTiles\n");
+            		return 1;
+            	}
+            break;
+            case 'b': // Opening book
+            	bookFile = optarg;
+            break;
+            case 'i': // Search in place instead of keeping a tree
+            	setInPlaceSearch(true);
+            break;
+            case 'T': // Think on a background thread while waiting for spawns
+            	setPondering(true);
+            break;
+            case 'w': // Milliseconds for each spawn to arrive
+            	setSpawnDelay(atoi(optarg));
+            break;
+            case 'o': // Result file
+            	resultFile = optarg;
+            break;
+            case 'p': // Depth policy
+            	if (!strcmp(optarg, "score"))
+            		dangerPolicy = false;
+            	else if (!strcmp(optarg, "danger"))
+            		dangerPolicy = true;
+            	else
+            	{
+            		printf("Depth policy must be score or danger\n");
+            		return 1;
+            	}
+            break;
+            case 'P': // Thresholds of the danger policy
+            	if (sscanf(optarg, "%u,%u,%u,%u,%u", &params.crowdedTiles, &params.manySeeds, &params.closeSeedsPercent,
+            	           &params.cheapBranching, &params.expensiveBranching) != 5)
+            	{
+            		printf("Depth params must be crowdedTiles,manySeeds,closeSeedsPercent,cheapBranching,expensiveBranching\n");
+            		return 1;
+            	}
+            break;
+            case 'C': // Dump sampled positions
+            	corpusFile = optarg;
+            break;
+            case 'I': // One in how many positions goes to the corpus
+            	sampler.sampleInterval = atoi(optarg);
+            	if (!sampler.sampleInterval)
+            	{
+            		printf("Sample interval must be at least 1\n");
+            		return 1;
+            	}
+            break;
+            case 'S': // Play only part i of N of the games
+            	if (sscanf(optarg, "%u/%u", &shard, &numShards) != 2 || shard >= numShards)
+            	{
+            		printf("Shard must be i/N with i < N\n");
+            		return 1;
+            	}
+            break;
             case 'h':
-            	printf("Usage: %s [-n ngames] [-d depth] [-s seed] [-v] [-r]\n", argv[0]);
+            	printf("Usage: %s [-n ngames] [-d depth] [-s seed] [-v] [-r] [-R rule|rollout] [--reset-params s,n,h,p,e] [-b book] [-i] [-T] [-w ms] [-o results] [--shard i/N] [-p score|danger] [--depth-params c,m,s,b,e] [--corpus file] [--sample k]\n", argv[0]);
             	return 0;
             case '?':
-                printf("Usage: %s [-n ngames] [-d depth] [-s seed] [-v] [-r]\n", argv[0]);
+                printf("Usage: %s [-n ngames] [-d depth] [-s seed] [-v] [-r] [-R rule|rollout] [--reset-params s,n,h,p,e] [-b book] [-i] [-T] [-w ms] [-o results] [--shard i/N] [-p score|danger] [--depth-params c,m,s,b,e] [--corpus file] [--sample k]\n", argv[0]);
                 return 1;
             default:
                 return 0;
 		}
 	}
 
+	if (bookFile && !loadBook(bookFile))
+		return 1;
+
+	setDepthPolicy(dangerPolicy ? dangerDepthPolicy : scoreDepthPolicy);
+	setDangerParams(params);
+	setResetPolicy(rolloutReset ? rolloutResetPolicy : ruleResetPolicy);
+	setRolloutParams(resetParams);
+
+	/* Game g is always played from rand seed seed + g, so any shard of a
+	 * run plays exactly the games the whole run would have.
+	 */
+	uint32_t firstGame;
+	uint32_t lastGame;
+	shardRange(ngames, shard, numShards, &firstGame, &lastGame);
+
+	FILE *results = NULL;
+	if (resultFile)
+	{
+		results = fopen(resultFile, "w");
+		if (!results)
+		{
+			perror(resultFile);
+			return 1;
+		}
+		resultsHeader header = {seed, ngames, depth, canReset, shard, numShards, "-", "score", "rule"};
+		bookId(header.book, sizeof header.book);
+		if (dangerPolicy)
+			snprintf(header.policy, sizeof header.policy, "danger:%u,%u,%u,%u,%u",
+				params.crowdedTiles, params.manySeeds, params.closeSeedsPercent, params.cheapBranching, params.expensiveBranching);
+		if (rolloutReset)
+			snprintf(header.resetPolicy, sizeof header.resetPolicy, "rollout:%u,%u,%u,%u,%u",
+				resetParams.maxScore, resetParams.rollouts, resetParams.horizon, resetParams.minSurvivalPercent, resetParams.crowdedTiles);
+		writeResultsHeader(results, &header);
+	}
+
+	ngames = lastGame - firstGame;
+
+	if (corpusFile)
+	{
+		sampler.f = fopen(corpusFile, "w");
+		if (!sampler.f)
+		{
+			perror(corpusFile);
+			return 1;
+		}
+		fprintf(sampler.f, "%s\n", CORPUS_HEADER);
+		setPositionHook(samplePosition, &sampler);
+	}
+
 	uint32_t updateInterval = 1;
 
-	srand(seed);
 	uint64_t totalScore = 0;
 	uint32_t aiHighScore = 0;
 	uint32_t *summary;
 	uint32_t score;
 	uint32_t nthMove;
-	uint32_t nResets;
+	uint32_t nResets = 0;
+	gameResult result;
 
 
 
@@ -88,7 +243,17 @@ int main(int argc, char **argv)
 	
 	for (int g = 0; g < ngames;)
 	{
-		summary = playGame(&score, &nthMove, depth, verbose, &nResets, canReset);
+		result = (gameResult) {firstGame + g, 0, 0, nResets};
+		srand(seed + firstGame + g);
+		summary = playGame(&score, &nthMove, depth, verbose, &nResets, canReset, result.depthTime);
+
+		if (results)
+		{
+			result.score = score;
+			result.moves = nthMove / 2 - 1;
+			result.resets = nResets - result.resets;
+			writeResult(results, &result);
+		}
 
 		totalScore += score;
 		aiHighScore = (aiHighScore > score) ? aiHighScore : score;
@@ -129,6 +294,11 @@ int main(int argc, char **argv)
 
 	//fclose(q);
 
+	if (results)
+		fclose(results);
+	if (sampler.f)
+		fclose(sampler.f);
+
 
 	return 0;
 }
@@ -0,0 +1,10 @@
+#ifndef DIVEREF_H_INCLUDED
+#define DIVEREF_H_INCLUDED
+
+#include "dive.h"
+
+void refUpdateSeeds(diveState *myState);
+void refShift(diveState *myState, dirType dir);
+diveState *refSpawnOptions(diveState myState, uint32_t *numOptions);
+
+#endif
@@ -0,0 +1,153 @@
+/* Merges the result files of a sharded run
+ *
+ * Checks that the files describe the same run and together cover every game
+ * exactly once, then prints the statistics diveAI would have printed for the
+ * whole run.  With -o the merged per-game results are written as the result
+ * file of a single unsharded run.
+ */
+
+#include "results.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+static bool sameRun(const resultsHeader *a, const resultsHeader *b)
+{
+	return a->seed == b->seed && a->ngames == b->ngames && a->depth == b->depth
+	    && a->canReset == b->canReset && a->numShards == b->numShards
+	    && !strcmp(a->book, b->book) && !strcmp(a->policy, b->policy)
+	    && !strcmp(a->resetPolicy, b->resetPolicy);
+}
+
+int main(int argc, char **argv)
+{
+	char *outFile = NULL;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"o:h"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'o': outFile = optarg; break;
+			default:
+				printf("Usage: %s [-o merged] shard0.txt shard1.txt ...\n", argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	if (optind == argc)
+	{
+		printf("Usage: %s [-o merged] shard0.txt shard1.txt ...\n", argv[0]);
+		return 1;
+	}
+
+	resultsHeader run;
+	gameResult *games = NULL;
+	bool *seen = NULL;
+	bool *shardSeen = NULL;
+
+	for (int i = optind; i < argc; ++i)
+	{
+		resultsHeader header;
+		uint32_t numResults;
+		gameResult *results = readResults(argv[i], &header, &numResults);
+		if (!results)
+			return 1;
+
+		if (i == optind)
+		{
+			run = header;
+			games = calloc(run.ngames, sizeof *games);
+			seen = calloc(run.ngames, sizeof *seen);
+			shardSeen = calloc(run.numShards, sizeof *shardSeen);
+		}
+		else if (!sameRun(&run, &header))
+		{
+			fprintf(stderr, "%s: not from the same run as %s\n", argv[i], argv[optind]);
+			return 1;
+		}
+
+		if (header.shard >= run.numShards || shardSeen[header.shard])
+		{
+			fprintf(stderr, "%s: shard %u/%u given twice or out of range\n", argv[i], header.shard, header.numShards);
+			return 1;
+		}
+		shardSeen[header.shard] = true;
+
+		uint32_t first, last;
+		shardRange(run.ngames, header.shard, run.numShards, &first, &last);
+		for (uint32_t n = 0; n < numResults; ++n)
+		{
+			uint32_t g = results[n].game;
+			if (g < first || g >= last || seen[g])
+			{
+				fprintf(stderr, "%s: game %u does not belong to shard %u or is repeated\n", argv[i], g, header.shard);
+				return 1;
+			}
+			seen[g] = true;
+			games[g] = results[n];
+		}
+
+		free(results);
+	}
+
+	for (uint32_t g = 0; g < run.ngames; ++g)
+		if (!seen[g])
+		{
+			fprintf(stderr, "Game %u missing: shard incomplete or not given\n", g);
+			return 1;
+		}
+
+	/* The same sums, in the same order, as diveAI keeps them */
+	uint64_t totalScore = 0;
+	uint32_t aiHighScore = 0;
+	uint32_t nResets = 0;
+	uint64_t totalMoves = 0;
+	double depthTime[NUM_DEPTH_TIMES] = {0};
+
+	for (uint32_t g = 0; g < run.ngames; ++g)
+	{
+		totalScore += games[g].score;
+		aiHighScore = (aiHighScore > games[g].score) ? aiHighScore : games[g].score;
+		nResets += games[g].resets;
+		totalMoves += games[g].moves;
+		for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+			depthTime[d] += games[g].depthTime[d];
+	}
+
+	uint32_t ngames = run.ngames;
+	printf("Games: %u (seed %u, depth %u%s) from %u shards\n", ngames, run.seed, run.depth, run.canReset ? ", resets" : "", run.numShards);
+	printf("Mean: %lu\n", ngames ? totalScore / ngames : 0);
+	printf("Highest: %u\n", aiHighScore);
+	if (run.canReset)
+		printf("Completed: %d / %u (%.1f%%)\n", ngames, nResets + ngames, (double) ngames / (nResets + ngames) * 100);
+	printf("Moves: %lu\n", (unsigned long) totalMoves);
+	printf("CPU seconds by depth:");
+	for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+		printf(d == NUM_DEPTH_TIMES - 1 ? " %u+: %.2f" : " %u: %.2f", d, depthTime[d]);
+	printf("\n");
+
+	if (outFile)
+	{
+		FILE *f = fopen(outFile, "w");
+		if (!f)
+		{
+			perror(outFile);
+			return 1;
+		}
+		run.shard = 0;
+		run.numShards = 1;
+		writeResultsHeader(f, &run);
+		for (uint32_t g = 0; g < ngames; ++g)
+			writeResult(f, games + g);
+		fclose(f);
+	}
+
+	free(games);
+	free(seen);
+	free(shardSeen);
+	return 0;
+}
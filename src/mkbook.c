@@ -0,0 +1,180 @@
+/* Opening book builder
+ *
+ * Plays the first few moves of many games at the book depth, in parallel,
+ * and records every position reached along with the move chosen there.
+ * Positions reached often enough are written to an opening book for
+ * `diveAI -b`.  Because the sample games are played with the deeper search,
+ * the positions sampled are the ones a game following the book will reach.
+ */
+
+#include "AI.h"
+#include "book.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+typedef struct {
+	diveState position;
+	dirType move;
+	bool valid;
+} sample;
+
+typedef struct {
+	sample *samples;
+	uint32_t movesPerGame;
+	uint32_t depth;
+	uint32_t seed;
+} sampleJob;
+
+static void sampleGame(uint32_t g, void *ctx)
+{
+	sampleJob *job = ctx;
+	sample *out = job->samples + (size_t) g * job->movesPerGame;
+	lookaheadTree myTree[4];
+	lookaheadTree temp;
+	float fitness[4];
+	uint32_t rng;
+	uint32_t numOptions;
+
+	srand(job->seed + g);
+	diveState game = initialState();
+	newSpawn(&game, &rng);
+	newSpawn(&game, &rng);
+	updateSeeds(&game);
+	initRoots(myTree, game);
+
+	for (uint32_t n = 0; n < job->movesPerGame && !game.gameOver; ++n)
+	{
+		dirType move = chooseMove(myTree, job->depth, fitness);
+		out[n] = (sample) {game, move, true};
+
+		temp = myTree[move];
+		for (uint32_t i = 0; i < 4; ++i)
+			if (i != move)
+				freeNode(myTree + i);
+
+		diveState *options = spawnOptions(temp.myState, &numOptions);
+		rng = rand() % numOptions;
+		game = options[rng];
+		free(options);
+
+		descendTree(myTree, &temp, rng, game);
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+		freeNode(myTree + i);
+}
+
+typedef struct {
+	uint64_t key;
+	uint32_t count;
+	uint32_t index;   // into the samples array
+} tally;
+
+static int byCount(const void *a, const void *b)
+{
+	const tally *x = a;
+	const tally *y = b;
+	return (x->count < y->count) - (x->count > y->count);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t ngames = 1000;
+	uint32_t movesPerGame = 8;
+	uint32_t minCount = 2;
+	uint32_t maxEntries = 100000;
+	uint32_t depth = 2;
+	uint32_t jobs = numCores();
+	uint32_t seed = time(NULL);
+	char *filename = NULL;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"n:m:c:k:d:j:s:o:h"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'n': ngames = atoi(optarg); break;
+			case 'm': movesPerGame = atoi(optarg); break;
+			case 'c': minCount = atoi(optarg); break;
+			case 'k': maxEntries = atoi(optarg); break;
+			case 'd': depth = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			case 's': seed = atoi(optarg); break;
+			case 'o': filename = optarg; break;
+			default:
+				printf("Usage: %s -o book [-n ngames] [-m moves] [-c mincount] [-k maxentries] [-d depth] [-j jobs] [-s seed]\n", argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	if (!filename)
+	{
+		printf("Usage: %s -o book [-n ngames] [-m moves] [-c mincount] [-k maxentries] [-d depth] [-j jobs] [-s seed]\n", argv[0]);
+		return 1;
+	}
+
+	populateHelpList();
+
+	size_t numSamples = (size_t) ngames * movesPerGame;
+	sampleJob job = {sharedAlloc(numSamples * sizeof(sample)), movesPerGame, depth, seed};
+
+	printf("Sampling %u games to move %u at depth %u on %u processes...\n", ngames, movesPerGame, depth, jobs);
+	runParallel(jobs, ngames, sampleGame, &job);
+
+	/* Count how often each position came up */
+	uint32_t slots = 1;
+	while (slots < 2 * numSamples)
+		slots <<= 1;
+	tally *tallies = calloc(slots, sizeof *tallies);
+	uint32_t distinct = 0;
+
+	for (size_t n = 0; n < numSamples; ++n)
+	{
+		if (!job.samples[n].valid)
+			continue;
+		uint64_t key = hashPosition(&job.samples[n].position);
+		uint32_t i = key & (slots - 1);
+		while (tallies[i].key && tallies[i].key != key)
+			i = (i + 1) & (slots - 1);
+		if (!tallies[i].key)
+		{
+			tallies[i] = (tally) {key, 0, n};
+			++distinct;
+		}
+		++tallies[i].count;
+	}
+
+	qsort(tallies, slots, sizeof *tallies, byCount);
+
+	uint32_t numEntries = 0;
+	while (numEntries < distinct && numEntries < maxEntries && tallies[numEntries].count >= minCount)
+		++numEntries;
+
+	diveState *positions = malloc(numEntries * sizeof *positions);
+	dirType *moves = malloc(numEntries * sizeof *moves);
+	for (uint32_t i = 0; i < numEntries; ++i)
+	{
+		positions[i] = job.samples[tallies[i].index].position;
+		moves[i] = job.samples[tallies[i].index].move;
+	}
+
+	if (!writeBook(filename, positions, moves, numEntries, depth))
+	{
+		fprintf(stderr, "Failed to write %s\n", filename);
+		return 1;
+	}
+
+	printf("%u distinct positions, %u seen at least %u times written to %s\n", distinct, numEntries, minCount, filename);
+
+	free(positions);
+	free(moves);
+	free(tallies);
+	sharedFree(job.samples, numSamples * sizeof(sample));
+	return 0;
+}
@@ -0,0 +1,78 @@
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "parallel.h"
+
+uint32_t numCores()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+void *sharedAlloc(size_t bytes)
+{
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+	{
+		perror("mmap");
+		exit(1);
+	}
+	return mem;
+}
+
+void sharedFree(void *mem, size_t bytes)
+{
+	munmap(mem, bytes);
+}
+
+void runParallel(uint32_t numWorkers, uint32_t numItems, void (*work)(uint32_t item, void *ctx), void *ctx)
+{
+	if (numWorkers > numItems)
+		numWorkers = numItems;
+
+	if (numWorkers <= 1)
+	{
+		for (uint32_t i = 0; i < numItems; ++i)
+			work(i, ctx);
+		return;
+	}
+
+	fflush(stdout);
+
+	uint32_t *nextItem = sharedAlloc(sizeof *nextItem);
+	*nextItem = 0;
+
+	for (uint32_t w = 0; w < numWorkers; ++w)
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			perror("fork");
+			exit(1);
+		}
+		if (pid == 0)
+		{
+			for (uint32_t i; (i = __atomic_fetch_add(nextItem, 1, __ATOMIC_RELAXED)) < numItems; )
+				work(i, ctx);
+			fflush(stdout);
+			_exit(0);
+		}
+	}
+
+	int status;
+	bool failed = false;
+	while (wait(&status) > 0)
+		failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+	sharedFree(nextItem, sizeof *nextItem);
+
+	if (failed)
+	{
+		fprintf(stderr, "A worker process failed\n");
+		exit(1);
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef PARALLEL_H_INCLUDED
+#define PARALLEL_H_INCLUDED
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Batch tools spread independent work items over worker processes.
+ * Processes rather than threads, because the AI keeps global state (the
+ * rng, counters) that is not meant to be shared.  Results come back through
+ * memory from sharedAlloc, which workers write and the parent reads after
+ * runParallel returns.
+ */
+
+uint32_t numCores();
+void *sharedAlloc(size_t bytes);
+void sharedFree(void *mem, size_t bytes);
+
+/* Calls work(item, ctx) once for every item in [0, numItems).  Workers claim
+ * the next unclaimed item as they finish one, so items of very different
+ * cost still keep every worker busy.  Returns once every worker has exited.
+ */
+void runParallel(uint32_t numWorkers, uint32_t numItems, void (*work)(uint32_t item, void *ctx), void *ctx);
+
+#endif
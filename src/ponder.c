@@ -0,0 +1,124 @@
+#include "ponder.h"
+
+#include <pthread.h>
+
+static pthread_t worker;
+static bool running = false;
+static bool stopRequested = false;   // atomic, read once per node
+
+static lookaheadTree *ponderTree;
+static uint32_t ponderDepth;
+
+static bool shouldStop()
+{
+	return __atomic_load_n(&stopRequested, __ATOMIC_RELAXED);
+}
+
+/* computeToDepth, giving up as soon as a stop is requested.  The stop is
+ * checked before every expansion, so stopPonder waits for one addChildren
+ * at most.  A subtree left partly expanded is still a valid tree, and the
+ * next search's computeToDepth expands whatever is missing.
+ */
+static bool deepen(lookaheadTree *root, uint32_t depth)
+{
+	if (shouldStop())
+		return false;
+
+	addChildren(root);
+	if (depth > 1)
+		for (uint32_t i = 0; i < root->numLeaves; ++i)
+			if (!deepen(root->leaves + i, depth - 1))
+				return false;
+	return true;
+}
+
+static void *ponder(void *arg)
+{
+	for (uint32_t i = 0; i < ponderTree->numLeaves; ++i)
+		if (!deepen(ponderTree->leaves + i, ponderDepth))
+			break;
+
+	return NULL;
+}
+
+void startPonder(lookaheadTree *chosen, uint32_t depth)
+{
+	if (running || !chosen->numLeaves || !depth)
+		return;
+
+	ponderTree = chosen;
+	ponderDepth = depth;
+	stopRequested = false;
+	running = !pthread_create(&worker, NULL, ponder, NULL);
+}
+
+void stopPonder()
+{
+	if (!running)
+		return;
+
+	__atomic_store_n(&stopRequested, true, __ATOMIC_RELAXED);
+
+	pthread_join(worker, NULL);
+	running = false;
+}
+
+/* Pondering deepens every spawn's subtree, so most of the work is thrown
+ * away once the spawn is known.  Freeing it is slow enough to show up in the
+ * time to the next move, so it is done on another thread.
+ */
+static pthread_t discarder;
+static bool discarding = false;
+static lookaheadTree discardTree;
+static uint32_t discardKeep;
+
+static void *discard(void *arg)
+{
+	for (uint32_t i = 0; i < discardTree.numLeaves / 4; ++i)
+		if (i != discardKeep)
+		{
+			freeNode(discardTree.leaves + 4*i);
+			freeNode(discardTree.leaves + 4*i + 1);
+			freeNode(discardTree.leaves + 4*i + 2);
+			freeNode(discardTree.leaves + 4*i + 3);
+		}
+	freeLeaves(&discardTree);
+	return NULL;
+}
+
+static void finishDiscard()
+{
+	if (discarding)
+		pthread_join(discarder, NULL);
+	discarding = false;
+}
+
+/* As descendTree, but freeing the other spawns in the background */
+void ponderDescend(lookaheadTree roots[4], lookaheadTree *chosen, uint32_t spawn, diveState game)
+{
+	if (!chosen->numLeaves)
+	{
+		initRoots(roots, game);
+		return;
+	}
+
+	finishDiscard();
+
+	roots[Up] = chosen->leaves[4*spawn];
+	roots[Right] = chosen->leaves[4*spawn+1];
+	roots[Down] = chosen->leaves[4*spawn+2];
+	roots[Left] = chosen->leaves[4*spawn+3];
+
+	discardTree = *chosen;
+	discardKeep = spawn;
+	discarding = !pthread_create(&discarder, NULL, discard, NULL);
+	if (!discarding)
+		discard(NULL);
+}
+
+/* Waits for all background work, e.g. before the game ends */
+void finishPondering()
+{
+	stopPonder();
+	finishDiscard();
+}
@@ -0,0 +1,22 @@
+#ifndef PONDER_H_INCLUDED
+#define PONDER_H_INCLUDED
+
+#include "AI.h"
+
+/* Pondering searches ahead on a background thread while the game waits for
+ * the next spawn.  Once a move is committed, the subtrees under every spawn
+ * of the chosen tree are deepened to the depth of the move just played.
+ * When the spawn arrives the worker is stopped, its finished work on the
+ * matching subtree is kept and the rest is discarded with the other spawns,
+ * freed on a second background thread by ponderDescend.
+ *
+ * Only the chosen tree is touched by the worker, and only one ponder can be
+ * running at a time.
+ */
+
+void startPonder(lookaheadTree *chosen, uint32_t depth);
+void stopPonder();
+void ponderDescend(lookaheadTree roots[4], lookaheadTree *chosen, uint32_t spawn, diveState game);
+void finishPondering();
+
+#endif
@@ -0,0 +1,111 @@
+#include "results.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void writeResultsHeader(FILE *f, const resultsHeader *header)
+{
+	fprintf(f, "# diveAI results v%d\n", RESULTS_VERSION);
+	fprintf(f, "# seed %u games %u depth %u reset %d shard %u/%u book %s policy %s resetpolicy %s\n",
+		header->seed, header->ngames, header->depth, header->canReset,
+		header->shard, header->numShards, header->book, header->policy, header->resetPolicy);
+	fprintf(f, "# game score moves");
+	for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+		fprintf(f, d == NUM_DEPTH_TIMES - 1 ? " time%u+" : " time%u", d);
+	fprintf(f, " resets\n");
+}
+
+void writeResult(FILE *f, const gameResult *result)
+{
+	fprintf(f, "%u %u %u", result->game, result->score, result->moves);
+	for (uint32_t d = 0; d < NUM_DEPTH_TIMES; ++d)
+		fprintf(f, " %.6f", result->depthTime[d]);
+	fprintf(f, " %u\n", result->resets);
+}
+
+/* Returns NULL and prints why if the file is missing or malformed */
+gameResult *readResults(const char *filename, resultsHeader *header, uint32_t *numResults)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+	{
+		perror(filename);
+		return NULL;
+	}
+
+	char line[512];
+	int version = 0;
+	int canReset = 0;
+	bool haveHeader = false;
+	uint32_t size = 1024;
+	gameResult *results = malloc(size * sizeof *results);
+	*numResults = 0;
+
+	if (!fgets(line, sizeof line, f) || sscanf(line, "# diveAI results v%d", &version) != 1 || version != RESULTS_VERSION)
+	{
+		fprintf(stderr, "%s: not a version %d result file\n", filename, RESULTS_VERSION);
+		goto fail;
+	}
+
+	while (fgets(line, sizeof line, f))
+	{
+		if (line[0] == '#')
+		{
+			char book[MAX_BOOK_NAME];
+			char policy[MAX_POLICY_NAME];
+			char resetPolicy[MAX_POLICY_NAME];
+			if (sscanf(line, "# seed %u games %u depth %u reset %d shard %u/%u book %63s policy %63s resetpolicy %63s",
+				&header->seed, &header->ngames, &header->depth, &canReset,
+				&header->shard, &header->numShards, book, policy, resetPolicy) == 9)
+			{
+				header->canReset = canReset;
+				strcpy(header->book, book);
+				strcpy(header->policy, policy);
+				strcpy(header->resetPolicy, resetPolicy);
+				haveHeader = true;
+			}
+			continue;
+		}
+
+		if (*numResults == size)
+			results = realloc(results, (size *= 2) * sizeof *results);
+
+		gameResult *r = results + *numResults;
+		int read = 0;
+		int n = sscanf(line, "%u %u %u%n", &r->game, &r->score, &r->moves, &read);
+		char *p = line + read;
+		for (uint32_t d = 0; n == 3 + d && d < NUM_DEPTH_TIMES; ++d)
+		{
+			char *end;
+			r->depthTime[d] = strtod(p, &end);
+			n += end != p;
+			p = end;
+		}
+		if (n != 3 + NUM_DEPTH_TIMES || sscanf(p, "%u", &r->resets) != 1)
+		{
+			fprintf(stderr, "%s: malformed line: %s", filename, line);
+			goto fail;
+		}
+		++*numResults;
+	}
+
+	if (!haveHeader)
+	{
+		fprintf(stderr, "%s: missing run description\n", filename);
+		goto fail;
+	}
+
+	fclose(f);
+	return results;
+
+	fail:
+	fclose(f);
+	free(results);
+	return NULL;
+}
+
+void shardRange(uint32_t ngames, uint32_t shard, uint32_t numShards, uint32_t *first, uint32_t *last)
+{
+	*first = (uint64_t) ngames * shard / numShards;
+	*last = (uint64_t) ngames * (shard + 1) / numShards;
+}
@@ -0,0 +1,46 @@
+#ifndef RESULTS_H_INCLUDED
+#define RESULTS_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "AI.h"
+
+/* Result files record every game of a run, one line each, so runs split
+ * into shards can be merged into the statistics of a single run.  The
+ * header records everything that decides which games are played.
+ */
+
+#define RESULTS_VERSION 4
+#define MAX_BOOK_NAME 64
+#define MAX_POLICY_NAME 64
+
+typedef struct {
+	uint32_t seed;
+	uint32_t ngames;
+	uint32_t depth;
+	bool canReset;
+	uint32_t shard;
+	uint32_t numShards;
+	char book[MAX_BOOK_NAME]; // bookId of the book, "-" if none
+	char policy[MAX_POLICY_NAME]; // depth policy and its parameters
+	char resetPolicy[MAX_POLICY_NAME]; // reset policy and its parameters
+} resultsHeader;
+
+typedef struct {
+	uint32_t game;
+	uint32_t score;
+	uint32_t moves;
+	uint32_t resets;
+	double depthTime[NUM_DEPTH_TIMES];
+} gameResult;
+
+void writeResultsHeader(FILE *f, const resultsHeader *header);
+void writeResult(FILE *f, const gameResult *result);
+gameResult *readResults(const char *filename, resultsHeader *header, uint32_t *numResults);
+
+/* The games [first, last) belonging to a shard */
+void shardRange(uint32_t ngames, uint32_t shard, uint32_t numShards, uint32_t *first, uint32_t *last);
+
+#endif
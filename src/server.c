@@ -0,0 +1,202 @@
+/* DIVE analysis server
+ *
+ * Reads positions one per line, in the format of writeState:
+ *
+ *   score numSeeds seed_1 ... seed_n board_0 ... board_15
+ *
+ * and answers each with one line:
+ *
+ *   move fitnessUp fitnessRight fitnessDown fitnessLeft nodes
+ *
+ * where move is 0-3 in the order Up, Right, Down, Left and nodes is the
+ * number of lookahead nodes allocated to answer the query.  Malformed input
+ * is answered with a line starting "error".
+ *
+ * The process stays up between queries, so the eval lookup table is built
+ * only once.  The lookahead tree of the last query is kept as well: if the
+ * next position is one that tree already considered (the usual case when a
+ * client plays a game through the server), the subtree is reused and only
+ * the new ply has to be searched.
+ */
+
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "AI.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+static lookaheadTree roots[4];
+static diveState rootState;
+static bool haveRoots = false;
+
+/* Point roots at a tree for game, reusing what the previous query built. */
+static void moveRoots(diveState game)
+{
+	if (haveRoots && samePosition(&rootState, &game))
+		return;
+
+	if (haveRoots)
+		for (uint32_t d = 0; d < 4; ++d)
+		{
+			if (!roots[d].numLeaves)
+				continue;
+
+			uint32_t numOptions;
+			diveState *options = spawnOptions(roots[d].myState, &numOptions);
+			uint32_t match = numOptions;
+			for (uint32_t i = 0; i < numOptions; ++i)
+				if (samePosition(options + i, &game))
+				{
+					match = i;
+					break;
+				}
+			free(options);
+
+			if (match == numOptions)
+				continue;
+
+			lookaheadTree temp = roots[d];
+			for (uint32_t i = 0; i < 4; ++i)
+				if (i != d)
+					freeNode(roots + i);
+			descendTree(roots, &temp, match, game);
+			rootState = game;
+			return;
+		}
+
+	if (haveRoots)
+		for (uint32_t i = 0; i < 4; ++i)
+			freeNode(roots + i);
+
+	initRoots(roots, game);
+	rootState = game;
+	haveRoots = true;
+}
+
+/* Answers queries until input ends or the client stops reading replies */
+static void serve(FILE *in, FILE *out, uint32_t depth)
+{
+	char line[512];
+	diveState game;
+	float fitness[4];
+
+	while (fgets(line, sizeof line, in) != NULL)
+	{
+		if (line[0] == '\n' || line[0] == '#')
+			continue;
+
+		if (!readState(line, &game))
+		{
+			if (fprintf(out, "error malformed position\n") < 0 || fflush(out))
+				return;
+			continue;
+		}
+
+		resetNodeCount();
+		moveRoots(game);
+		dirType move = chooseMove(roots, depth, fitness);
+
+		if (fprintf(out, "%d %.3f %.3f %.3f %.3f %lu\n", move,
+			fitness[Up], fitness[Right], fitness[Down], fitness[Left],
+			(unsigned long) getNodeCount()) < 0 || fflush(out))
+			return;
+	}
+}
+
+static int listenOn(const char *path)
+{
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof addr.sun_path)
+	{
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof addr) || listen(sock, 8))
+	{
+		perror(path);
+		return -1;
+	}
+	return sock;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t depth = 1;
+	char *socketPath = NULL;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"d:u:h"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'd': // AI depth
+				depth = atoi(optarg);
+			break;
+			case 'u': // Unix socket instead of stdin
+				socketPath = optarg;
+			break;
+			case 'h':
+				printf("Usage: %s [-d depth] [-u socket]\n", argv[0]);
+				return 0;
+			default:
+				printf("Usage: %s [-d depth] [-u socket]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	populateHelpList();
+
+	if (!socketPath)
+	{
+		serve(stdin, stdout, depth);
+		return 0;
+	}
+
+	int sock = listenOn(socketPath);
+	if (sock < 0)
+		return 1;
+
+	/* A client hanging up before its reply must not kill the server */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* One client at a time; the tree carries over between clients too */
+	for (;;)
+	{
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0)
+			continue;
+		FILE *in = fdopen(conn, "r");
+		if (!in)
+		{
+			perror("fdopen");
+			close(conn);
+			continue;
+		}
+		int outFd = dup(conn);
+		FILE *out = (outFd < 0) ? NULL : fdopen(outFd, "w");
+		if (!out)
+		{
+			perror("fdopen");
+			if (outFd >= 0)
+				close(outFd);
+			fclose(in);
+			continue;
+		}
+		serve(in, out, depth);
+		fclose(in);
+		fclose(out);
+	}
+}
@@ -0,0 +1,400 @@
+/* Differential checker for the game kernels
+ *
+ * Runs states through the reference kernels in diveRef.c and through every
+ * kernel set registered below, and compares the complete resulting states.
+ * States are either generated at random or taken from every position of
+ * the replays named on the command line.
+ *
+ * Each random state is generated from (seed, index) alone, so any mismatch
+ * can be reproduced with `verify -s seed -i index`.  Random states are
+ * checked in chunks spread over one process per core.
+ */
+
+#define _DEFAULT_SOURCE  // clock_gettime
+
+#include "dive.h"
+#include "diveRef.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+typedef struct {
+	const char *name;
+	void (*shift)(diveState *myState, dirType dir);
+	void (*updateSeeds)(diveState *myState);
+	diveState *(*spawnOptions)(diveState myState, uint32_t *numOptions);
+} kernelSet;
+
+/* Every implementation of the kernels used by the AI goes here.  The
+ * make/unmake kernels of searchInPlace don't fit this shape and are checked
+ * by checkInPlace.
+ */
+static const kernelSet kernels[] = {
+	{"dive.c", shift, updateSeeds, spawnOptions},
+};
+
+static const uint32_t numKernels = sizeof kernels / sizeof kernels[0];
+static const uint32_t numKernelSets = sizeof kernels / sizeof kernels[0] + 1; // and in-place
+
+static const char *dirNames[4] = {"Up", "Right", "Down", "Left"};
+
+/* Where a state came from: a replay entry if file is set, otherwise a
+ * random state.  Only formatted when a mismatch is reported.
+ */
+typedef struct {
+	const char *file;
+	uint32_t seed;
+	uint32_t index;
+} origin;
+
+static uint64_t checked = 0;
+static uint32_t mismatches = 0;
+static uint32_t maxMismatches = 10;
+
+/* Full comparison, including the derived fields */
+static bool identical(const diveState *a, const diveState *b)
+{
+	return samePosition(a, b)
+	    && a->maxTile == b->maxTile && a->submaxTile == b->submaxTile
+	    && a->biggestSeed == b->biggestSeed && a->secondBiggestSeed == b->secondBiggestSeed
+	    && a->emptyTiles == b->emptyTiles && a->gameOver == b->gameOver;
+}
+
+static void dumpState(const char *label, const diveState *s)
+{
+	printf("  %-11s", label);
+	writeState(stdout, s);
+	printf("  %-11smax %u %u, seeds %u %u, empty %u, gameOver %d\n", "",
+		s->maxTile, s->submaxTile, s->biggestSeed, s->secondBiggestSeed, s->emptyTiles, s->gameOver);
+}
+
+static void report(const char *kernel, const char *op, origin from, const diveState *input, const diveState *want, const diveState *got)
+{
+	if (++mismatches > maxMismatches)
+		return;
+	if (from.file)
+		printf("MISMATCH %s %s on %s entry %u\n", kernel, op, from.file, from.index);
+	else
+		printf("MISMATCH %s %s on -s %u -i %u\n", kernel, op, from.seed, from.index);
+	dumpState("input", input);
+	dumpState("reference", want);
+	dumpState(kernel, got);
+}
+
+/* The reference results for one input state, computed once for all kernels */
+typedef struct {
+	diveState seeded;
+	diveState shifted[4];
+	diveState *options;
+	uint32_t numOptions;
+} reference;
+
+/* Moves and spawns made in place must match the reference, and undoing them
+ * must give back exactly the state before.  Spawns are compared one at a
+ * time as they are made.
+ */
+static void checkInPlace(const diveState *input, const reference *ref, origin from)
+{
+	char op[32];
+	moveUndo undo;
+	diveState got = *input;
+
+	for (uint32_t d = 0; d < 4; ++d)
+	{
+		makeMove(&got, (dirType) d, &undo);
+		if (!identical(ref->shifted + d, &got))
+		{
+			sprintf(op, "makeMove %s", dirNames[d]);
+			report("in-place", op, from, input, ref->shifted + d, &got);
+		}
+		unmakeMove(&got, &undo);
+		if (!identical(input, &got))
+		{
+			sprintf(op, "unmakeMove %s", dirNames[d]);
+			report("in-place", op, from, input, input, &got);
+			got = *input;
+		}
+	}
+
+	spawnIterator it;
+	initSpawns(&it, &got);
+	if (it.numOptions != ref->numOptions)
+	{
+		sprintf(op, "spawns count %u/%u", it.numOptions, ref->numOptions);
+		report("in-place", op, from, input, input, input);
+		return;
+	}
+	while (applySpawn(&it, &got))
+	{
+		if (!identical(ref->options + it.last, &got))
+		{
+			sprintf(op, "applySpawn #%u", it.last);
+			report("in-place", op, from, input, ref->options + it.last, &got);
+			break;
+		}
+		undoSpawn(&it, &got);
+		if (!identical(input, &got))
+		{
+			sprintf(op, "undoSpawn #%u", it.last);
+			report("in-place", op, from, input, input, &got);
+			break;
+		}
+	}
+}
+
+static void checkState(const diveState *input, origin from)
+{
+	char op[32];
+	reference ref;
+
+	ref.seeded = *input;
+	refUpdateSeeds(&ref.seeded);
+	for (uint32_t d = 0; d < 4; ++d)
+	{
+		ref.shifted[d] = *input;
+		refShift(ref.shifted + d, (dirType) d);
+	}
+	ref.options = refSpawnOptions(*input, &ref.numOptions);
+
+	for (uint32_t k = 0; k < numKernels; ++k)
+	{
+		const kernelSet *ks = kernels + k;
+
+		diveState got = *input;
+		ks->updateSeeds(&got);
+		if (!identical(&ref.seeded, &got))
+			report(ks->name, "updateSeeds", from, input, &ref.seeded, &got);
+
+		for (uint32_t d = 0; d < 4; ++d)
+		{
+			got = *input;
+			ks->shift(&got, (dirType) d);
+			if (!identical(ref.shifted + d, &got))
+			{
+				sprintf(op, "shift %s", dirNames[d]);
+				report(ks->name, op, from, input, ref.shifted + d, &got);
+			}
+		}
+
+		uint32_t numGot;
+		diveState *gotOptions = ks->spawnOptions(*input, &numGot);
+		if (ref.numOptions != numGot)
+		{
+			sprintf(op, "spawnOptions count %u/%u", numGot, ref.numOptions);
+			report(ks->name, op, from, input, input, input);
+		}
+		else
+			for (uint32_t i = 0; i < numGot; ++i)
+				if (!identical(ref.options + i, gotOptions + i))
+				{
+					sprintf(op, "spawnOptions #%u", i);
+					report(ks->name, op, from, input, ref.options + i, gotOptions + i);
+					break;
+				}
+		free(gotOptions);
+	}
+
+	checkInPlace(input, &ref, from);
+
+	free(ref.options);
+	++checked;
+}
+
+/* splitmix64, so a state depends only on its seed and index */
+static uint64_t nextRandom(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/* Boards are built from products of the seeds so that merges, seed
+ * elimination and unlocking all come up often.  A few tiles get a stray
+ * factor to unlock new seeds, few enough that the seed list can't overflow.
+ */
+static diveState randomState(uint32_t seed, uint32_t index)
+{
+	static const uint32_t pool[] = {2, 3, 4, 5, 6, 7, 9, 10, 11, 13, 15, 17, 19, 23, 29, 31, 37, 89};
+	static const uint32_t poolSize = sizeof pool / sizeof pool[0];
+	uint64_t x = ((uint64_t) seed << 32) | index;
+	diveState s = {{0}};
+
+	s.numSeeds = 1 + nextRandom(&x) % 5;
+	for (uint32_t i = 0; i < s.numSeeds; ++i)
+	{
+		bool repeat;
+		do {
+			s.seeds[i] = pool[nextRandom(&x) % poolSize];
+			repeat = false;
+			for (uint32_t j = 0; j < i; ++j)
+				repeat |= s.seeds[j] == s.seeds[i];
+		} while (repeat);
+	}
+
+	uint32_t fill = nextRandom(&x) % 17;
+	uint32_t strays = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (nextRandom(&x) % 16 >= fill)
+			continue;
+		uint32_t val = s.seeds[nextRandom(&x) % s.numSeeds];
+		for (uint32_t f = nextRandom(&x) % 4; f > 0; --f)
+			val *= s.seeds[nextRandom(&x) % s.numSeeds];
+		if (strays < 4 && nextRandom(&x) % 10 == 0)
+		{
+			val *= pool[nextRandom(&x) % poolSize];
+			++strays;
+		}
+		s.board[i] = val;
+	}
+
+	s.score = nextRandom(&x) % 1000000;
+	refreshState(&s);
+	s.gameOver = nextRandom(&x) % 50 == 0;
+	return s;
+}
+
+#define CHUNK_SIZE 65536
+
+typedef struct {
+	uint32_t seed;
+	uint32_t count;
+	uint64_t *checked;     // per chunk, shared with the parent
+	uint32_t *mismatches;
+} randomJob;
+
+static void checkChunk(uint32_t chunk, void *ctx)
+{
+	randomJob *job = ctx;
+	uint64_t checkedBefore = checked;
+	uint32_t mismatchesBefore = mismatches;
+
+	for (uint32_t i = chunk * CHUNK_SIZE; i < job->count && i < (chunk + 1) * CHUNK_SIZE; ++i)
+	{
+		diveState s = randomState(job->seed, i);
+		checkState(&s, (origin) {NULL, job->seed, i});
+	}
+
+	job->checked[chunk] = checked - checkedBefore;
+	job->mismatches[chunk] = mismatches - mismatchesBefore;
+	fflush(stdout);
+}
+
+/* Checks the position after every spawn and every move of a replay.  Returns
+ * false if the replay can't be read or holds a move or spawn that isn't
+ * possible, after checking the positions before it.
+ */
+static bool checkReplay(const char *filename)
+{
+	uint32_t numEntries;
+	uint32_t numOptions;
+	uint32_t *summary = readReplay(filename, &numEntries);
+
+	if (!summary)
+		return false;
+
+	bool consistent = true;
+	diveState game = initialState();
+	for (uint32_t n = 0; n < numEntries; ++n)
+	{
+		if (n >= 2 && n % 2 == 0)
+		{
+			if (summary[n] > Left)
+			{
+				consistent = false;
+				break;
+			}
+			refShift(&game, (dirType) summary[n]);
+		}
+		else
+		{
+			diveState *options = refSpawnOptions(game, &numOptions);
+			if (summary[n] >= numOptions)
+			{
+				free(options);
+				consistent = false;
+				break;
+			}
+			game = options[summary[n]];
+			free(options);
+			if (n == 1)
+				refUpdateSeeds(&game);
+		}
+
+		checkState(&game, (origin) {filename, 0, n});
+	}
+
+	free(summary);
+	return consistent;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t count = 1000000;
+	uint32_t seed = time(NULL);
+	uint32_t jobs = numCores();
+	int64_t only = -1;
+
+	int opt;
+
+	while ((opt=getopt(argc,argv,"n:s:i:m:j:h"))!=-1)
+	{
+		switch (opt)
+		{
+			case 'n': count = atoi(optarg); break;
+			case 's': seed = atoi(optarg); break;
+			case 'i': only = atoi(optarg); break;
+			case 'm': maxMismatches = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			default:
+				printf("Usage: %s [-n count] [-s seed] [-i index] [-m maxreported] [-j jobs] [Game1.txt ...]\n", argv[0]);
+				return opt != 'h';
+		}
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (only >= 0)
+	{
+		diveState s = randomState(seed, only);
+		dumpState("state", &s);
+		checkState(&s, (origin) {NULL, seed, only});
+	}
+	else if (count)
+	{
+		uint32_t chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		randomJob job = {seed, count, sharedAlloc(chunks * sizeof(uint64_t)), sharedAlloc(chunks * sizeof(uint32_t))};
+		runParallel(jobs, chunks, checkChunk, &job);
+
+		/* Totals from the workers; run inline they are already counted */
+		checked = mismatches = 0;
+		for (uint32_t c = 0; c < chunks; ++c)
+		{
+			checked += job.checked[c];
+			mismatches += job.mismatches[c];
+		}
+		sharedFree(job.checked, chunks * sizeof(uint64_t));
+		sharedFree(job.mismatches, chunks * sizeof(uint32_t));
+	}
+
+	uint32_t badReplays = 0;
+	for (int i = optind; i < argc; ++i)
+		if (!checkReplay(argv[i]))
+		{
+			fprintf(stderr, "%s: unreadable or inconsistent replay\n", argv[i]);
+			++badReplays;
+		}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%lu states checked against %u kernel set(s) in %.2f s (%.0f states/s), %u mismatches\n",
+		(unsigned long) checked, numKernelSets, seconds, checked / (seconds > 0 ? seconds : 1), mismatches);
+
+	return (mismatches || badReplays) ? 1 : 0;
+}